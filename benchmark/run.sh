@@ -0,0 +1,58 @@
+#!/bin/bash
+declare -a file_array=(
+    "optdigits"
+    "pageblocks"
+    "penbased"
+    "satimage"
+    "shuttle"
+    "texture"
+    "winequality-white"
+)
+
+declare -a benchmark_array=(
+    "tree"
+    "split"
+    "predict"
+    "parse"
+    "knn"
+    "ann"
+    "kmeans"
+)
+
+KNN=5
+K_FOLD=5
+TEST_TIME=5
+
+MIN_SAMPLES_SPLIT=10
+MAX_PURITY=0.95
+SPLIT_ALGORITHM="exact"
+N_THREADS=0
+RP_TREES=8
+MINI_BATCH_SIZE=1024
+SEED=0
+
+CMAKE_OPTIONS="
+    -DKNN=${KNN}
+    -DK_FOLD=${K_FOLD}
+    -DTEST_TIME=${TEST_TIME}
+    -DMIN_SAMPLES_SPLIT=${MIN_SAMPLES_SPLIT}
+    -DMAX_PURITY=${MAX_PURITY}
+    -DSPLIT_ALGORITHM="${SPLIT_ALGORITHM}"
+    -DN_THREADS=${N_THREADS}
+    -DRP_TREES=${RP_TREES}
+    -DMINI_BATCH_SIZE=${MINI_BATCH_SIZE}
+    -DSEED=${SEED}
+"
+mkdir -p build
+cd build
+cmake -DCMAKE_BUILD_TYPE=Release $CMAKE_OPTIONS ..
+make
+
+for benchmark in "${benchmark_array[@]}"
+do
+    for file in "${file_array[@]}"
+    do
+        echo "========== $file ($benchmark) ==========="
+        ./main "$file" "$benchmark"
+    done
+done
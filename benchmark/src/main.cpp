@@ -0,0 +1,858 @@
+#include <ctime>          // timespec, clock_gettime
+#include <numeric>        // std::accumulate
+#include <queue>          // std::priority_queue
+#include <sys/resource.h> // getrusage
+#include "../../inc/file_operations.h"          // ReadTrainingAndTestingSet, ReadDataMatrix, MapBinaryFold
+#include "../../inc/decision_tree_classifier.h" // CreateDecisionTree, CompileDecisionTree, PredictBatchByFlatTree
+#include "../../inc/validation.h"               // Validation
+#include "../../inc/nearest_neighbors.h"        // FindKNearestNeighbors, FindApproximateKNearestNeighbors, FindNeighborsInRadius
+#include "../../proposed/inc/proposed.h"        // Proposed
+#include "../../comparing_algorithms/edited_nearest_neighbors/inc/edited_nearest_neighbors.h" // EditedNearestNeighbors
+#include "../../comparing_algorithms/cluster_centroids/inc/k_means_pp.h" // KMeansPP
+
+static float ElapsedTimeMs(const timespec &start_ns, const timespec &end_ns)
+{
+    return (float)(end_ns.tv_sec - start_ns.tv_sec) * 1000 + 
+                (float)(end_ns.tv_nsec - start_ns.tv_nsec) / 1000000;
+}
+
+static float PeakRssMb()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (float)usage.ru_maxrss / 1024; // ru_maxrss is reported in KB on Linux
+}
+
+// The getline/stringstream/stof reader that ReadDataMatrix replaced, kept as the parse baseline
+static void ReadDatasetLegacy(std::vector<std::vector<float>> &dataset, const std::string file_path)
+{
+    std::ifstream file;
+    file.open(file_path, std::ios::in);
+    if (!file.is_open()){
+        printf("./%s:%d: error: open file error\n", __FILE__, __LINE__);
+        exit(1);
+    }
+
+    std::string file_row;
+    while (getline(file, file_row)){
+        std::stringstream ss(file_row);
+        std::string attribute;
+        std::vector<float> data_row;
+        
+        while(getline(ss, attribute, ',')){
+            data_row.push_back(std::stof(attribute.c_str()));
+        }
+        dataset.push_back(data_row);
+    }
+    file.close();
+}
+
+#define LEGACY_IDX 0
+#define LEGACY_VALUE 1
+#define LEGACY_LABEL 2
+
+static float CustomRoundLegacy(float x){
+    return std::round(x * 1e6) / 1e6;
+}
+
+static float CalculateGiniLegacy(const uint32_t partition_size_y, std::vector<uint32_t> &class_counts_y, 
+                                    const uint32_t partition_size_n, const std::vector<uint32_t> &class_counts_n)
+{
+    float gini_y = 1.0;
+    if(partition_size_y > 0){
+        for(uint32_t class_idx = 1; class_idx < class_counts_y.size(); class_idx++){
+            float class_ratio = (float)class_counts_y[class_idx] / partition_size_y;
+            gini_y -= class_ratio * class_ratio; 
+        }
+    }
+   
+    float gini_n = 1.0;
+    if(partition_size_n > 0){
+        for(uint32_t class_idx = 1; class_idx < class_counts_n.size(); class_idx++){
+            float class_ratio = (float)class_counts_n[class_idx] / partition_size_n;
+            gini_n -= class_ratio * class_ratio; 
+        }
+    }
+
+    return (float)partition_size_y / (partition_size_y + partition_size_n) * gini_y +
+                                    (float)partition_size_n / (partition_size_y + partition_size_n) * gini_n;
+}
+
+static SplitPoint EvaluateSplitPointLegacy(const std::vector<std::vector<std::vector<float>>> &sorted_features, const std::vector<bool> &is_existing_data, 
+                                            const uint32_t n_classes, const uint32_t feature_idx)
+{
+    SplitPoint best = {feature_idx, 0.f, 1.1};
+    uint32_t best_split_left_idx = 0, best_split_right_idx = 0;
+    uint32_t split_left_idx = 0, split_right_idx = 0;
+    
+    uint32_t partition_size_y = 0;
+    std::vector<uint32_t> class_counts_y(n_classes + 1, 0);
+    std::vector<uint32_t> class_counts_n(n_classes + 1, 0);
+    for(uint32_t idx = 0; idx < sorted_features[feature_idx].size(); idx++){
+        uint32_t data_idx = sorted_features[feature_idx][idx][LEGACY_IDX];
+        if(is_existing_data[data_idx]){
+            uint32_t label = sorted_features[feature_idx][idx][LEGACY_LABEL];
+            if(partition_size_y == 0){
+                partition_size_y++;
+                class_counts_y[label]++;
+                split_right_idx = idx;
+            }
+            else{
+                class_counts_n[label]++;
+            }
+        }
+    }
+    uint32_t partition_size_n = std::accumulate(class_counts_n.begin(), class_counts_n.end(), 0.f);
+
+    float best_weighted_gini = 1.1;
+    while(split_left_idx < sorted_features[feature_idx].size() && split_right_idx < sorted_features[feature_idx].size()){
+        split_left_idx = split_right_idx;
+        for(split_right_idx = split_left_idx + 1; split_right_idx < sorted_features[feature_idx].size(); split_right_idx++){
+            uint32_t data_idx = sorted_features[feature_idx][split_right_idx][LEGACY_IDX];
+            uint32_t label    = sorted_features[feature_idx][split_right_idx][LEGACY_LABEL];
+            bool is_diff = CustomRoundLegacy(sorted_features[feature_idx][split_left_idx][LEGACY_VALUE]) != 
+                                CustomRoundLegacy(sorted_features[feature_idx][split_right_idx][LEGACY_VALUE]);
+
+            if(is_existing_data[data_idx]){
+                if(is_diff){
+                    float weighted_gini = CalculateGiniLegacy(partition_size_y, class_counts_y, partition_size_n, class_counts_n);
+                    if(weighted_gini < best_weighted_gini){
+                        best_weighted_gini = weighted_gini;
+                        best_split_left_idx = split_left_idx;
+                        best_split_right_idx = split_right_idx;
+                    }
+                    partition_size_y++;
+                    class_counts_y[label]++;
+                    partition_size_n--;
+                    class_counts_n[label]--; 
+                    break;
+                }
+                partition_size_y++;
+                class_counts_y[label]++;
+                partition_size_n--;
+                class_counts_n[label]--;    
+            } 
+        }
+    }
+    
+    best.score = best_weighted_gini;
+    best.value = (sorted_features[feature_idx][best_split_left_idx][LEGACY_VALUE] + 
+                    sorted_features[feature_idx][best_split_right_idx][LEGACY_VALUE]) / 2;
+    return best;
+}
+
+static void FindBestSplitPointLegacy(TreeNode *node, const std::vector<std::vector<std::vector<float>>> &sorted_features, std::vector<bool> &is_existing_data, 
+                                        const uint32_t n_classes, const uint32_t min_samples_split, const float max_purity)
+{       
+    std::vector<uint32_t> class_counts((n_classes + 1), 0);
+    for(uint32_t idx = 0; idx < sorted_features[0].size(); idx++){
+        uint32_t data_idx = sorted_features[0][idx][LEGACY_IDX];
+        if(is_existing_data[data_idx]){
+            uint32_t label = sorted_features[0][idx][LEGACY_LABEL];
+            class_counts[label]++;
+        }
+    }
+    
+    auto max_it = std::max_element(class_counts.begin(), class_counts.end());
+    const uint32_t majority_label = std::distance(class_counts.begin(), max_it);
+    const uint32_t majority_count = *max_it;
+
+    const uint32_t partition_size = std::count_if(is_existing_data.begin(), is_existing_data.end(), 
+                                                    [](bool is_existing){return is_existing;});
+    if(partition_size <= min_samples_split || (float)majority_count / partition_size >= max_purity){
+        node->label = majority_label;
+        return;
+    }   
+    node->split_point = {0, 0.f, 1.1};
+    
+    const uint32_t n_features = (sorted_features.size());
+    for(uint32_t feature_idx = 0; feature_idx < n_features; feature_idx++){
+        SplitPoint feature_best_split_point = EvaluateSplitPointLegacy(sorted_features, is_existing_data, n_classes, feature_idx);
+        if(node->split_point.score >= feature_best_split_point.score){
+            memcpy(&(node->split_point), &(feature_best_split_point), sizeof(SplitPoint));
+        }
+    }
+    
+    bool split_partition_y = false, split_partition_n = false;
+    std::vector<bool> is_existing_data_y(is_existing_data.size(), false);
+    std::vector<bool> is_existing_data_n(is_existing_data.size(), false);
+    for(uint32_t sorted_data_idx = 0; sorted_data_idx < sorted_features[node->split_point.feature].size(); sorted_data_idx++){
+        uint32_t data_idx = sorted_features[node->split_point.feature][sorted_data_idx][LEGACY_IDX];
+        if(is_existing_data[data_idx]){
+            float data_attr = sorted_features[node->split_point.feature][sorted_data_idx][LEGACY_VALUE];
+            if(data_attr <= node->split_point.value){
+                is_existing_data_y[data_idx] = true;
+                split_partition_y = true;
+            }
+            else{
+                is_existing_data_n[data_idx] = true;
+                split_partition_n = true;
+            }
+        }
+    }
+    
+    if(split_partition_y){
+        node->left_child = new TreeNode;
+        node->left_child->left_child = NULL;
+        node->left_child->right_child = NULL;
+        FindBestSplitPointLegacy(node->left_child, sorted_features, is_existing_data_y, n_classes, min_samples_split, max_purity);
+    }
+    if(split_partition_n){
+        node->right_child = new TreeNode;
+        node->right_child->left_child = NULL;
+        node->right_child->right_child = NULL;
+        FindBestSplitPointLegacy(node->right_child, sorted_features, is_existing_data_n, n_classes, min_samples_split, max_purity);
+    }
+}
+
+// The nested-vector builder that CreateDecisionTree replaced, kept as the tree build baseline
+// Every (idx, value, label) triple of sorted_features is a heap allocation of its own. Free the tree with DeleteDecisionTreeLegacy
+static TreeNode* CreateDecisionTreeLegacy(const std::vector<std::vector<float>> &training_set, const uint32_t n_classes, 
+                                            const uint32_t min_samples_split, const float max_purity)
+{
+    TreeNode *root = new TreeNode;
+    root->left_child = NULL;
+    root->right_child = NULL;
+
+    // dimension * data_size * 3(idx, value, label)
+    std::vector<std::vector<std::vector<float>>> sorted_features(training_set[0].size() - 1, std::vector<std::vector<float>>(training_set.size(), std::vector<float>(3, 0.f)));
+    
+    const uint32_t label_idx = training_set[0].size() - 1;
+    for(uint32_t feature_idx = 0; feature_idx < training_set[0].size() - 1; feature_idx++){
+        for(uint32_t data_idx = 0; data_idx < training_set.size(); data_idx++){
+            sorted_features[feature_idx][data_idx][LEGACY_IDX]   = data_idx;
+            sorted_features[feature_idx][data_idx][LEGACY_VALUE] = training_set[data_idx][feature_idx];
+            sorted_features[feature_idx][data_idx][LEGACY_LABEL] = training_set[data_idx][label_idx];
+        }
+        std::sort(sorted_features[feature_idx].begin(), sorted_features[feature_idx].end(), 
+                    [](const std::vector<float> &a, const std::vector<float> &b){return a[LEGACY_VALUE] < b[LEGACY_VALUE];});
+    }
+
+    std::vector<bool> is_existing_data(training_set.size(), true);
+    FindBestSplitPointLegacy(root, sorted_features, is_existing_data, n_classes, min_samples_split, max_purity);
+    return root;
+}
+
+static void DeleteDecisionTreeLegacy(TreeNode *node)
+{
+    if(node->left_child != NULL){
+        DeleteDecisionTreeLegacy(node->left_child);
+    }
+    if(node->right_child != NULL){
+        DeleteDecisionTreeLegacy(node->right_child);
+    }
+    delete node;
+}
+
+// Same shape, same splits and same leaf labels, the split scores are not compared
+static bool IsSameDecisionTree(const TreeNode *node, const TreeNode *other_node)
+{
+    if((node->left_child == NULL) != (other_node->left_child == NULL) || (node->right_child == NULL) != (other_node->right_child == NULL)){
+        return false;
+    }
+    if(node->left_child == NULL && node->right_child == NULL){
+        return node->label == other_node->label;
+    }
+    return node->split_point.feature == other_node->split_point.feature && node->split_point.value == other_node->split_point.value &&
+            (node->left_child == NULL || IsSameDecisionTree(node->left_child, other_node->left_child)) &&
+            (node->right_child == NULL || IsSameDecisionTree(node->right_child, other_node->right_child));
+}
+
+// Time TEST_TIME tree builds on every fold with CreateDecisionTree and with the legacy builder, and report the average
+// build times, the peak RSS of each and the folds whose trees differ. The new builder runs on every fold first,
+// because the peak RSS only ever grows
+static void BenchmarkTreeBuild(const std::string &file_path)
+{
+    std::vector<Dataset> datasets;
+    for(uint32_t k = 1; k <= K_FOLD; k++){
+        std::string training_path = file_path + std::to_string(k) + "tra.dat";
+        std::string testing_path = file_path + std::to_string(k) + "tst.dat";
+        datasets.push_back(ReadTrainingAndTestingSet(training_path, testing_path));
+    }
+    // The rows the legacy builder takes, the label last
+    std::vector<std::vector<std::vector<float>>> legacy_training_sets(K_FOLD);
+    for(uint32_t fold_idx = 0; fold_idx < K_FOLD; fold_idx++){
+        const DataMatrix &training_set = datasets[fold_idx].training_set;
+        for(uint32_t data_idx = 0; data_idx < training_set.n_samples; data_idx++){
+            legacy_training_sets[fold_idx].emplace_back(training_set.Row(data_idx), training_set.Row(data_idx) + training_set.n_features);
+            legacy_training_sets[fold_idx].back().push_back(training_set.labels[data_idx]);
+        }
+    }
+    const float dataset_rss_mb = PeakRssMb();
+
+    std::vector<float> build_time_ms;
+    for(uint32_t fold_idx = 0; fold_idx < K_FOLD; fold_idx++){
+        for(uint32_t test_time = 0; test_time < TEST_TIME; test_time++){
+            timespec start_ns = {0}, end_ns = {0};
+            clock_gettime(CLOCK_MONOTONIC, &start_ns);
+            CreateDecisionTree(datasets[fold_idx].training_set, datasets[fold_idx].n_classes, MIN_SAMPLES_SPLIT, MAX_PURITY, SPLIT_ALGORITHM, N_THREADS);
+            clock_gettime(CLOCK_MONOTONIC, &end_ns);
+            build_time_ms.push_back(ElapsedTimeMs(start_ns, end_ns));
+        }
+    }
+    const float peak_rss_mb = PeakRssMb();
+
+    std::vector<float> legacy_build_time_ms;
+    for(uint32_t fold_idx = 0; fold_idx < K_FOLD; fold_idx++){
+        for(uint32_t test_time = 0; test_time < TEST_TIME; test_time++){
+            timespec start_ns = {0}, end_ns = {0};
+            clock_gettime(CLOCK_MONOTONIC, &start_ns);
+            TreeNode *root = CreateDecisionTreeLegacy(legacy_training_sets[fold_idx], datasets[fold_idx].n_classes, MIN_SAMPLES_SPLIT, MAX_PURITY);
+            clock_gettime(CLOCK_MONOTONIC, &end_ns);
+            legacy_build_time_ms.push_back(ElapsedTimeMs(start_ns, end_ns));
+            DeleteDecisionTreeLegacy(root);
+        }
+    }
+    const float legacy_peak_rss_mb = PeakRssMb();
+
+    // The legacy builder only knows the exact split finding
+    uint32_t n_mismatches = 0;
+    if((std::string)SPLIT_ALGORITHM == "exact"){
+        for(uint32_t fold_idx = 0; fold_idx < K_FOLD; fold_idx++){
+            DecisionTree decision_tree = CreateDecisionTree(datasets[fold_idx].training_set, datasets[fold_idx].n_classes, 
+                                                                MIN_SAMPLES_SPLIT, MAX_PURITY, SPLIT_ALGORITHM, N_THREADS);
+            TreeNode *root = CreateDecisionTreeLegacy(legacy_training_sets[fold_idx], datasets[fold_idx].n_classes, MIN_SAMPLES_SPLIT, MAX_PURITY);
+            n_mismatches += !IsSameDecisionTree(decision_tree.root, root);
+            DeleteDecisionTreeLegacy(root);
+        }
+    }
+
+    std::cout << "legacy_build_ms     " << std::accumulate(legacy_build_time_ms.begin(), legacy_build_time_ms.end(), 0.f) / legacy_build_time_ms.size() << std::endl;
+    std::cout << "tree_build_ms       " << std::accumulate(build_time_ms.begin(), build_time_ms.end(), 0.f) / build_time_ms.size() << std::endl;
+    std::cout << "dataset_rss_mb      " << dataset_rss_mb << std::endl;
+    std::cout << "peak_rss_mb         " << peak_rss_mb << std::endl;
+    std::cout << "legacy_peak_rss_mb  " << legacy_peak_rss_mb << std::endl;
+    std::cout << "tree_mismatches     " << n_mismatches << std::endl;
+}
+
+// Compare the build time and the testing G-mean of the exact and the histogram split finding
+static void BenchmarkSplitAlgorithms(const std::string &file_path)
+{
+    const std::string split_algorithms[] = {"exact", "histogram"};
+    for(const std::string &split_algorithm : split_algorithms){
+        ModelParameters model_parameters = {
+            .model_type = "decision_tree",
+            .min_samples_split = MIN_SAMPLES_SPLIT,
+            .max_purity = MAX_PURITY,
+            .split_algorithm = split_algorithm,
+            .n_threads = N_THREADS
+        };
+
+        std::vector<float> build_time_ms, g_mean;
+        for(uint32_t k = 1; k <= K_FOLD; k++){
+            std::string training_path = file_path + std::to_string(k) + "tra.dat";
+            std::string testing_path = file_path + std::to_string(k) + "tst.dat";
+            Dataset dataset = ReadTrainingAndTestingSet(training_path, testing_path);
+
+            for(uint32_t test_time = 0; test_time < TEST_TIME; test_time++){
+                timespec start_ns = {0}, end_ns = {0};
+                clock_gettime(CLOCK_MONOTONIC, &start_ns);
+                CreateDecisionTree(dataset.training_set, dataset.n_classes, MIN_SAMPLES_SPLIT, MAX_PURITY, split_algorithm, N_THREADS);
+                clock_gettime(CLOCK_MONOTONIC, &end_ns);
+                build_time_ms.push_back(ElapsedTimeMs(start_ns, end_ns));
+            }
+            g_mean.push_back(Validation(dataset.training_set, dataset.testing_set, dataset.n_classes, model_parameters).g_mean);
+        }
+
+        std::cout << split_algorithm << "_build_ms " << std::accumulate(build_time_ms.begin(), build_time_ms.end(), 0.f) / build_time_ms.size() << std::endl;
+        std::cout << split_algorithm << "_g_mean   " << std::accumulate(g_mean.begin(), g_mean.end(), 0.f) / g_mean.size() << std::endl;
+    }
+}
+
+// Time prediction over the whole training set with the pointer-based tree, the flattened tree and the batch API
+static void BenchmarkPrediction(const std::string &file_path)
+{
+    std::vector<float> pointer_time_ms, flat_time_ms, batch_time_ms;
+    uint32_t n_mismatches = 0;
+    for(uint32_t k = 1; k <= K_FOLD; k++){
+        std::string training_path = file_path + std::to_string(k) + "tra.dat";
+        std::string testing_path = file_path + std::to_string(k) + "tst.dat";
+        Dataset dataset = ReadTrainingAndTestingSet(training_path, testing_path);
+        DecisionTree decision_tree = CreateDecisionTree(dataset.training_set, dataset.n_classes, MIN_SAMPLES_SPLIT, MAX_PURITY, SPLIT_ALGORITHM, N_THREADS);
+        TreeNode *root = decision_tree.root;
+        FlatTree tree = CompileDecisionTree(root);
+
+        const uint32_t n_samples = dataset.training_set.n_samples;
+        const uint32_t n_features = dataset.training_set.n_features;
+        std::vector<float> samples((size_t)n_features * n_samples);
+        for(uint32_t feature_idx = 0; feature_idx < n_features; feature_idx++){
+            const ColumnView column = dataset.training_set.Column(feature_idx);
+            for(uint32_t sample_idx = 0; sample_idx < n_samples; sample_idx++){
+                samples[(size_t)feature_idx * n_samples + sample_idx] = column[sample_idx];
+            }
+        }
+
+        std::vector<uint32_t> pointer_labels(n_samples), flat_labels(n_samples), batch_labels(n_samples);
+        for(uint32_t test_time = 0; test_time < TEST_TIME; test_time++){
+            timespec start_ns = {0}, end_ns = {0};
+            clock_gettime(CLOCK_MONOTONIC, &start_ns);
+            for(uint32_t sample_idx = 0; sample_idx < n_samples; sample_idx++){
+                pointer_labels[sample_idx] = PredictByDecisionTree(root, dataset.training_set.Row(sample_idx));
+            }
+            clock_gettime(CLOCK_MONOTONIC, &end_ns);
+            pointer_time_ms.push_back(ElapsedTimeMs(start_ns, end_ns));
+
+            clock_gettime(CLOCK_MONOTONIC, &start_ns);
+            for(uint32_t sample_idx = 0; sample_idx < n_samples; sample_idx++){
+                flat_labels[sample_idx] = PredictByFlatTree(tree, dataset.training_set.Row(sample_idx));
+            }
+            clock_gettime(CLOCK_MONOTONIC, &end_ns);
+            flat_time_ms.push_back(ElapsedTimeMs(start_ns, end_ns));
+
+            clock_gettime(CLOCK_MONOTONIC, &start_ns);
+            PredictBatchByFlatTree(tree, samples.data(), n_samples, n_samples, batch_labels.data());
+            clock_gettime(CLOCK_MONOTONIC, &end_ns);
+            batch_time_ms.push_back(ElapsedTimeMs(start_ns, end_ns));
+        }
+
+        for(uint32_t sample_idx = 0; sample_idx < n_samples; sample_idx++){
+            n_mismatches += (pointer_labels[sample_idx] != flat_labels[sample_idx]) || (pointer_labels[sample_idx] != batch_labels[sample_idx]);
+        }
+    }
+
+    std::cout << "pointer_predict_ms " << std::accumulate(pointer_time_ms.begin(), pointer_time_ms.end(), 0.f) / pointer_time_ms.size() << std::endl;
+    std::cout << "flat_predict_ms    " << std::accumulate(flat_time_ms.begin(), flat_time_ms.end(), 0.f) / flat_time_ms.size() << std::endl;
+    std::cout << "batch_predict_ms   " << std::accumulate(batch_time_ms.begin(), batch_time_ms.end(), 0.f) / batch_time_ms.size() << std::endl;
+    std::cout << "label_mismatches   " << n_mismatches << std::endl;
+}
+
+// Parse throughput of every fold file with the legacy reader and with ReadDataMatrix,
+// and the load time of the binary fold files when the dataset has been converted
+static void BenchmarkParse(const std::string &file_path)
+{
+    std::vector<std::string> fold_paths;
+    for(uint32_t k = 1; k <= K_FOLD; k++){
+        fold_paths.push_back(file_path + std::to_string(k) + "tra.dat");
+        fold_paths.push_back(file_path + std::to_string(k) + "tst.dat");
+    }
+    size_t n_bytes = 0;
+    for(const std::string &fold_path : fold_paths){
+        struct stat file_stat;
+        if(stat(fold_path.c_str(), &file_stat) != 0){
+            printf("./%s:%d: error: open file error\n", __FILE__, __LINE__);
+            exit(1);
+        }
+        n_bytes += file_stat.st_size;
+    }
+
+    float legacy_time_ms = 0.f, mmap_time_ms = 0.f, binary_time_ms = 0.f;
+    uint32_t n_binary_files = 0;
+    for(uint32_t test_time = 0; test_time < TEST_TIME; test_time++){
+        for(const std::string &fold_path : fold_paths){
+            timespec start_ns = {0}, end_ns = {0};
+            clock_gettime(CLOCK_MONOTONIC, &start_ns);
+            std::vector<std::vector<float>> rows;
+            ReadDatasetLegacy(rows, fold_path);
+            clock_gettime(CLOCK_MONOTONIC, &end_ns);
+            legacy_time_ms += ElapsedTimeMs(start_ns, end_ns);
+
+            clock_gettime(CLOCK_MONOTONIC, &start_ns);
+            DataMatrix matrix;
+            ReadDataMatrix(matrix, fold_path, NULL);
+            clock_gettime(CLOCK_MONOTONIC, &end_ns);
+            mmap_time_ms += ElapsedTimeMs(start_ns, end_ns);
+
+            clock_gettime(CLOCK_MONOTONIC, &start_ns);
+            BinaryFold binary_fold;
+            if(MapBinaryFold(binary_fold, BinaryFoldPath(fold_path))){
+                DataMatrix binary_matrix;
+                ReadBinaryFold(binary_matrix, binary_fold, NULL);
+                UnmapBinaryFold(binary_fold);
+                clock_gettime(CLOCK_MONOTONIC, &end_ns);
+                binary_time_ms += ElapsedTimeMs(start_ns, end_ns);
+                n_binary_files += (test_time == 0);
+            }
+        }
+    }
+    legacy_time_ms /= TEST_TIME;
+    mmap_time_ms /= TEST_TIME;
+    binary_time_ms /= TEST_TIME;
+
+    std::cout << "fold_files_mb    " << (float)n_bytes / (1 << 20) << std::endl;
+    std::cout << "legacy_parse_ms  " << legacy_time_ms << std::endl;
+    std::cout << "mmap_parse_ms    " << mmap_time_ms << std::endl;
+    std::cout << "legacy_mb_per_s  " << (float)n_bytes / (1 << 20) / legacy_time_ms * 1000 << std::endl;
+    std::cout << "mmap_mb_per_s    " << (float)n_bytes / (1 << 20) / mmap_time_ms * 1000 << std::endl;
+    std::cout << "binary_files     " << n_binary_files << "/" << fold_paths.size() << std::endl;
+    std::cout << "binary_load_ms   " << binary_time_ms << std::endl;
+}
+
+// Neighbours as CalculateSamplingWeights used to find them: a std::priority_queue over every point
+static void FindKNearestNeighborsLegacy(const DataMatrix &training_set, const std::vector<uint32_t> &ks, 
+                                            std::vector<std::vector<std::pair<uint32_t, float>>> &neighbors)
+{
+    neighbors.assign(training_set.n_samples, {});
+    for(uint32_t src_idx = 0; src_idx < training_set.n_samples; src_idx++){
+        auto compare = [](const std::pair<uint32_t, float> &a, const std::pair<uint32_t, float> &b){return a.second < b.second;};
+        std::priority_queue<std::pair<uint32_t, float>, std::vector<std::pair<uint32_t, float>>, decltype(compare)> k_nearest_neighbors(compare);
+        for(uint32_t dst_idx = 0; dst_idx < training_set.n_samples; dst_idx++){
+            float square_distance = 0;
+            for(uint32_t feature_idx = 0; feature_idx < training_set.n_features; feature_idx++){
+                float diff = training_set.Row(src_idx)[feature_idx] - training_set.Row(dst_idx)[feature_idx];
+                square_distance += diff * diff;
+            }
+            k_nearest_neighbors.push({dst_idx, sqrt(square_distance)});
+            if(k_nearest_neighbors.size() > ks[src_idx]){
+                k_nearest_neighbors.pop();
+            }
+        }
+        while(!k_nearest_neighbors.empty()){
+            neighbors[src_idx].push_back(k_nearest_neighbors.top());
+            k_nearest_neighbors.pop();
+        }
+    }
+}
+
+// Every point within radius of every query by a scan over all points, ordered like NeighborLists
+static void FindNeighborsInRadiusBruteForce(const DataMatrix &training_set, const float radius, NeighborLists &neighbor_lists)
+{
+    neighbor_lists.offsets.assign(1, 0);
+    neighbor_lists.idxes.clear();
+    neighbor_lists.distances.clear();
+    std::vector<std::pair<float, uint32_t>> neighbors;
+    for(uint32_t src_idx = 0; src_idx < training_set.n_samples; src_idx++){
+        neighbors.clear();
+        for(uint32_t dst_idx = 0; dst_idx < training_set.n_samples; dst_idx++){
+            float square_distance = 0;
+            for(uint32_t feature_idx = 0; feature_idx < training_set.n_features; feature_idx++){
+                float diff = training_set.Row(dst_idx)[feature_idx] - training_set.Row(src_idx)[feature_idx];
+                square_distance += diff * diff;
+            }
+            if(square_distance <= radius * radius){
+                neighbors.push_back({square_distance, dst_idx});
+            }
+        }
+        std::sort(neighbors.begin(), neighbors.end());
+        for(const std::pair<float, uint32_t> &neighbor : neighbors){
+            neighbor_lists.idxes.push_back(neighbor.second);
+            neighbor_lists.distances.push_back(sqrt(neighbor.first));
+        }
+        neighbor_lists.offsets.push_back(neighbor_lists.idxes.size());
+    }
+}
+
+// Time the sqrt(class count) nearest neighbours of every training sample, the query of CalculateSamplingWeights
+// A query whose neighbour set differs from the legacy one only counts as a mismatch if the legacy set is not
+// also a valid answer, i.e. the differing neighbours are not tied at the k-th distance.
+// Then time FindNeighborsInRadius against a scan over all points, with the median k-th neighbour distance as the radius,
+// a query whose neighbours or distances differ at all is a mismatch
+static void BenchmarkKNearestNeighbors(const std::string &file_path)
+{
+    float legacy_time_ms = 0.f, engine_time_ms = 0.f, brute_force_radius_time_ms = 0.f, radius_time_ms = 0.f;
+    uint32_t n_tied_queries = 0, n_mismatches = 0, n_radius_mismatches = 0;
+    uint64_t n_radius_queries = 0, n_radius_neighbors = 0;
+    for(uint32_t k = 1; k <= K_FOLD; k++){
+        std::string training_path = file_path + std::to_string(k) + "tra.dat";
+        std::string testing_path = file_path + std::to_string(k) + "tst.dat";
+        Dataset dataset = ReadTrainingAndTestingSet(training_path, testing_path);
+        const DataMatrix &training_set = dataset.training_set;
+        const uint32_t n_samples = training_set.n_samples;
+
+        const std::vector<uint32_t> &class_counts = dataset.class_statistics.class_counts;
+        std::vector<uint32_t> ks(n_samples);
+        for(uint32_t data_idx = 0; data_idx < n_samples; data_idx++){
+            ks[data_idx] = sqrt(class_counts[training_set.labels[data_idx]]);
+        }
+        const PointSet points = MatrixPoints(training_set, NULL);
+
+        timespec start_ns = {0}, end_ns = {0};
+        clock_gettime(CLOCK_MONOTONIC, &start_ns);
+        std::vector<std::vector<std::pair<uint32_t, float>>> legacy_neighbors;
+        FindKNearestNeighborsLegacy(training_set, ks, legacy_neighbors);
+        clock_gettime(CLOCK_MONOTONIC, &end_ns);
+        legacy_time_ms += ElapsedTimeMs(start_ns, end_ns);
+
+        clock_gettime(CLOCK_MONOTONIC, &start_ns);
+        NeighborLists neighbor_lists;
+        FindKNearestNeighbors(points, points, ks.data(), N_THREADS, neighbor_lists);
+        clock_gettime(CLOCK_MONOTONIC, &end_ns);
+        engine_time_ms += ElapsedTimeMs(start_ns, end_ns);
+
+        for(uint32_t data_idx = 0; data_idx < n_samples; data_idx++){
+            std::vector<uint32_t> legacy_idxes, engine_idxes;
+            float kth_distance = 0.f;
+            for(const std::pair<uint32_t, float> &neighbor : legacy_neighbors[data_idx]){
+                legacy_idxes.push_back(neighbor.first);
+                kth_distance = std::max(kth_distance, neighbor.second);
+            }
+            engine_idxes.assign(neighbor_lists.idxes.begin() + neighbor_lists.offsets[data_idx], 
+                                    neighbor_lists.idxes.begin() + neighbor_lists.offsets[data_idx + 1]);
+            std::sort(legacy_idxes.begin(), legacy_idxes.end());
+            std::sort(engine_idxes.begin(), engine_idxes.end());
+            if(legacy_idxes == engine_idxes){
+                continue;
+            }
+
+            bool is_tie = legacy_idxes.size() == engine_idxes.size();
+            for(uint32_t neighbor_idx = neighbor_lists.offsets[data_idx]; neighbor_idx < neighbor_lists.offsets[data_idx + 1]; neighbor_idx++){
+                if(!std::binary_search(legacy_idxes.begin(), legacy_idxes.end(), neighbor_lists.idxes[neighbor_idx])){
+                    is_tie = is_tie && neighbor_lists.distances[neighbor_idx] == kth_distance;
+                }
+            }
+            n_tied_queries += is_tie;
+            n_mismatches += !is_tie;
+        }
+
+        std::vector<float> kth_distances;
+        for(uint32_t data_idx = 0; data_idx < n_samples; data_idx++){
+            if(neighbor_lists.offsets[data_idx + 1] > neighbor_lists.offsets[data_idx]){
+                kth_distances.push_back(neighbor_lists.distances[neighbor_lists.offsets[data_idx + 1] - 1]);
+            }
+        }
+        if(kth_distances.empty()){
+            continue;
+        }
+        std::nth_element(kth_distances.begin(), kth_distances.begin() + kth_distances.size() / 2, kth_distances.end());
+        const float radius = kth_distances[kth_distances.size() / 2];
+
+        clock_gettime(CLOCK_MONOTONIC, &start_ns);
+        NeighborLists brute_force_radius_lists;
+        FindNeighborsInRadiusBruteForce(training_set, radius, brute_force_radius_lists);
+        clock_gettime(CLOCK_MONOTONIC, &end_ns);
+        brute_force_radius_time_ms += ElapsedTimeMs(start_ns, end_ns);
+
+        clock_gettime(CLOCK_MONOTONIC, &start_ns);
+        NeighborLists radius_lists;
+        FindNeighborsInRadius(points, points, radius, N_THREADS, radius_lists);
+        clock_gettime(CLOCK_MONOTONIC, &end_ns);
+        radius_time_ms += ElapsedTimeMs(start_ns, end_ns);
+
+        for(uint32_t data_idx = 0; data_idx < n_samples; data_idx++){
+            const uint32_t begin = radius_lists.offsets[data_idx], end = radius_lists.offsets[data_idx + 1];
+            const uint32_t brute_force_begin = brute_force_radius_lists.offsets[data_idx];
+            n_radius_mismatches += end - begin != brute_force_radius_lists.offsets[data_idx + 1] - brute_force_begin ||
+                                    !std::equal(radius_lists.idxes.begin() + begin, radius_lists.idxes.begin() + end, 
+                                                    brute_force_radius_lists.idxes.begin() + brute_force_begin) ||
+                                    !std::equal(radius_lists.distances.begin() + begin, radius_lists.distances.begin() + end, 
+                                                    brute_force_radius_lists.distances.begin() + brute_force_begin);
+        }
+        n_radius_queries += n_samples;
+        n_radius_neighbors += radius_lists.idxes.size();
+    }
+
+    std::cout << "legacy_knn_ms      " << legacy_time_ms / K_FOLD << std::endl;
+    std::cout << "engine_knn_ms      " << engine_time_ms / K_FOLD << std::endl;
+    std::cout << "tie_broken_queries " << n_tied_queries << std::endl;
+    std::cout << "knn_mismatches     " << n_mismatches << std::endl;
+    std::cout << "scan_radius_ms     " << brute_force_radius_time_ms / K_FOLD << std::endl;
+    std::cout << "engine_radius_ms   " << radius_time_ms / K_FOLD << std::endl;
+    std::cout << "radius_neighbors   " << (double)n_radius_neighbors / std::max(n_radius_queries, (uint64_t)1) << std::endl;
+    std::cout << "radius_mismatches  " << n_radius_mismatches << std::endl;
+}
+
+// Compare the random projection forest with the exact search: time and recall of the sqrt(class count) nearest
+// neighbours of every training sample, then the testing macro-F1 and G-mean of Proposed and ENN resampled with each
+static void BenchmarkApproximateNearestNeighbors(const std::string &file_path)
+{
+    const std::string knn_algorithms[] = {"exact", "rp_forest"};
+    ModelParameters model_parameters = {
+        .model_type = "decision_tree",
+        .min_samples_split = MIN_SAMPLES_SPLIT,
+        .max_purity = MAX_PURITY,
+        .split_algorithm = SPLIT_ALGORITHM,
+        .n_threads = N_THREADS
+    };
+
+    float exact_time_ms = 0.f, approximate_time_ms = 0.f;
+    uint64_t n_exact_neighbors = 0, n_found_neighbors = 0;
+    std::vector<float> f1_score[2][2], g_mean[2][2]; // [undersampler][knn algorithm], Proposed then ENN
+    std::mt19937 gen((SEED == 0)? std::random_device()() : SEED);
+    for(uint32_t k = 1; k <= K_FOLD; k++){
+        std::string training_path = file_path + std::to_string(k) + "tra.dat";
+        std::string testing_path = file_path + std::to_string(k) + "tst.dat";
+        Dataset dataset = ReadTrainingAndTestingSet(training_path, testing_path);
+        const DataMatrix &training_set = dataset.training_set;
+        const uint32_t n_samples = training_set.n_samples;
+
+        const std::vector<uint32_t> &class_counts = dataset.class_statistics.class_counts;
+        std::vector<uint32_t> ks(n_samples);
+        for(uint32_t data_idx = 0; data_idx < n_samples; data_idx++){
+            ks[data_idx] = sqrt(class_counts[training_set.labels[data_idx]]);
+        }
+        const PointSet points = MatrixPoints(training_set, NULL);
+
+        timespec start_ns = {0}, end_ns = {0};
+        clock_gettime(CLOCK_MONOTONIC, &start_ns);
+        NeighborLists exact_neighbor_lists;
+        FindKNearestNeighbors(points, points, ks.data(), N_THREADS, exact_neighbor_lists);
+        clock_gettime(CLOCK_MONOTONIC, &end_ns);
+        exact_time_ms += ElapsedTimeMs(start_ns, end_ns);
+
+        clock_gettime(CLOCK_MONOTONIC, &start_ns);
+        NeighborLists approximate_neighbor_lists;
+        FindApproximateKNearestNeighbors(points, points, ks.data(), RP_TREES, N_THREADS, approximate_neighbor_lists);
+        clock_gettime(CLOCK_MONOTONIC, &end_ns);
+        approximate_time_ms += ElapsedTimeMs(start_ns, end_ns);
+
+        // Recall is the share of the exact neighbours that the forest also returns
+        for(uint32_t data_idx = 0; data_idx < n_samples; data_idx++){
+            std::vector<uint32_t> exact_idxes(exact_neighbor_lists.idxes.begin() + exact_neighbor_lists.offsets[data_idx], 
+                                                exact_neighbor_lists.idxes.begin() + exact_neighbor_lists.offsets[data_idx + 1]);
+            std::vector<uint32_t> approximate_idxes(approximate_neighbor_lists.idxes.begin() + approximate_neighbor_lists.offsets[data_idx], 
+                                                    approximate_neighbor_lists.idxes.begin() + approximate_neighbor_lists.offsets[data_idx + 1]);
+            std::sort(exact_idxes.begin(), exact_idxes.end());
+            std::sort(approximate_idxes.begin(), approximate_idxes.end());
+            std::vector<uint32_t> found_idxes;
+            std::set_intersection(exact_idxes.begin(), exact_idxes.end(), approximate_idxes.begin(), approximate_idxes.end(), std::back_inserter(found_idxes));
+            n_exact_neighbors += exact_idxes.size();
+            n_found_neighbors += found_idxes.size();
+        }
+
+        for(uint32_t knn_algorithm_idx = 0; knn_algorithm_idx < 2; knn_algorithm_idx++){
+            NeighborSearchParameters neighbor_search_parameters = {
+                .algorithm = knn_algorithms[knn_algorithm_idx],
+                .n_trees = RP_TREES,
+                .n_threads = N_THREADS
+            };
+            // Proposed draws its samples at random, so it is averaged over TEST_TIME runs, ENN is deterministic
+            for(uint32_t test_time = 0; test_time < TEST_TIME; test_time++){
+                std::vector<uint32_t> selected_idxes;
+                Proposed(training_set, dataset.class_statistics, KNN, model_parameters, neighbor_search_parameters, gen, selected_idxes);
+                Accuracies accuracies = Validation(training_set, selected_idxes, dataset.testing_set, dataset.n_classes, model_parameters);
+                f1_score[0][knn_algorithm_idx].push_back(accuracies.macro_f1_score);
+                g_mean[0][knn_algorithm_idx].push_back(accuracies.g_mean);
+            }
+            std::vector<uint32_t> selected_idxes;
+            EditedNearestNeighbors(training_set, dataset.class_statistics, KNN, neighbor_search_parameters, selected_idxes);
+            Accuracies accuracies = Validation(training_set, selected_idxes, dataset.testing_set, dataset.n_classes, model_parameters);
+            f1_score[1][knn_algorithm_idx].push_back(accuracies.macro_f1_score);
+            g_mean[1][knn_algorithm_idx].push_back(accuracies.g_mean);
+        }
+    }
+
+    std::cout << "exact_knn_ms       " << exact_time_ms / K_FOLD << std::endl;
+    std::cout << "rp_forest_knn_ms   " << approximate_time_ms / K_FOLD << std::endl;
+    std::cout << "rp_forest_recall   " << (double)n_found_neighbors / n_exact_neighbors << std::endl;
+    const std::string undersamplers[] = {"proposed", "enn"};
+    for(uint32_t undersampler_idx = 0; undersampler_idx < 2; undersampler_idx++){
+        for(uint32_t knn_algorithm_idx = 0; knn_algorithm_idx < 2; knn_algorithm_idx++){
+            const std::vector<float> &f1 = f1_score[undersampler_idx][knn_algorithm_idx];
+            const std::vector<float> &gm = g_mean[undersampler_idx][knn_algorithm_idx];
+            std::string name = undersamplers[undersampler_idx] + "_" + knn_algorithms[knn_algorithm_idx];
+            std::cout << name << "_f1_score " << std::accumulate(f1.begin(), f1.end(), 0.f) / f1.size() << std::endl;
+            std::cout << name << "_g_mean   " << std::accumulate(gm.begin(), gm.end(), 0.f) / gm.size() << std::endl;
+        }
+    }
+}
+
+// SSE of the samples dataset[sample_idxes[...]] to their nearest centroid
+static double KMeansSSE(const DataMatrix &dataset, const std::vector<uint32_t> &sample_idxes, const DataMatrix &centroids)
+{
+    std::vector<uint32_t> ks(sample_idxes.size(), 1);
+    NeighborLists nearest_centroids;
+    FindKNearestNeighbors(MatrixPoints(centroids, NULL), MatrixPoints(dataset, &sample_idxes), ks.data(), N_THREADS, nearest_centroids);
+    double sse = 0;
+    for(float distance : nearest_centroids.distances){
+        sse += (double)distance * distance;
+    }
+    return sse;
+}
+
+// Run KMeansPP on every class of every fold with the cluster count of ClusterCentroids (the smallest class size)
+// and every algorithm, each from the same generator state. Hamerly and auto must return the centroids of Lloyd's algorithm,
+// mini-batch is reported by its SSE relative to Lloyd's. Seeding alone is timed by runs that stop after one iteration,
+// k-means|| seeding by the SSE of Lloyd's algorithm from its seeds relative to the one from k-means++ seeds.
+static void BenchmarkKMeans(const std::string &file_path)
+{
+    const std::string kmeans_algorithms[] = {"lloyd", "hamerly", "auto", "minibatch"};
+    const std::string init_algorithms[] = {"kmeans++", "kmeans||"};
+    float seeding_time_ms[2] = {0.f}, kmeans_time_ms[4] = {0.f};
+    double lloyd_sse = 0, minibatch_sse = 0, parallel_seeded_sse = 0;
+    uint32_t n_runs = 0, n_mismatches = 0;
+    std::mt19937 gen((SEED == 0)? std::random_device()() : SEED);
+    for(uint32_t k = 1; k <= K_FOLD; k++){
+        std::string training_path = file_path + std::to_string(k) + "tra.dat";
+        std::string testing_path = file_path + std::to_string(k) + "tst.dat";
+        Dataset dataset = ReadTrainingAndTestingSet(training_path, testing_path);
+        const DataMatrix &training_set = dataset.training_set;
+
+        const std::vector<std::vector<uint32_t>> &samples_by_class = dataset.class_statistics.data_idxes_by_class;
+        const uint32_t n_clusters = dataset.class_statistics.class_counts[SmallestClass(dataset.class_statistics)];
+
+        for(uint32_t class_idx = 1; class_idx <= dataset.n_classes; class_idx++){
+            if(samples_by_class[class_idx].size() <= n_clusters){
+                continue;
+            }
+            for(uint32_t test_time = 0; test_time < TEST_TIME; test_time++){
+                const std::mt19937 run_gen = gen;
+                gen.discard(1);
+
+                timespec start_ns = {0}, end_ns = {0};
+                for(uint32_t init_algorithm_idx = 0; init_algorithm_idx < 2; init_algorithm_idx++){
+                    std::mt19937 seeding_gen = run_gen;
+                    KMeansParameters seeding_parameters = {0, 1e-4, "lloyd", MINI_BATCH_SIZE, init_algorithms[init_algorithm_idx], N_THREADS};
+                    clock_gettime(CLOCK_MONOTONIC, &start_ns);
+                    KMeansPP(training_set, samples_by_class[class_idx], n_clusters, seeding_parameters, seeding_gen);
+                    clock_gettime(CLOCK_MONOTONIC, &end_ns);
+                    seeding_time_ms[init_algorithm_idx] += ElapsedTimeMs(start_ns, end_ns);
+                }
+                std::mt19937 parallel_seeded_gen = run_gen;
+                KMeansParameters parallel_seeded_parameters = {100, 1e-4, "lloyd", MINI_BATCH_SIZE, "kmeans||", N_THREADS};
+                parallel_seeded_sse += KMeansSSE(training_set, samples_by_class[class_idx], 
+                                                    KMeansPP(training_set, samples_by_class[class_idx], n_clusters, parallel_seeded_parameters, parallel_seeded_gen));
+
+                DataMatrix centroids[4];
+                for(uint32_t kmeans_algorithm_idx = 0; kmeans_algorithm_idx < 4; kmeans_algorithm_idx++){
+                    std::mt19937 kmeans_gen = run_gen;
+                    KMeansParameters kmeans_parameters = {100, 1e-4, kmeans_algorithms[kmeans_algorithm_idx], MINI_BATCH_SIZE, "kmeans++", N_THREADS};
+                    clock_gettime(CLOCK_MONOTONIC, &start_ns);
+                    centroids[kmeans_algorithm_idx] = KMeansPP(training_set, samples_by_class[class_idx], n_clusters, kmeans_parameters, kmeans_gen);
+                    clock_gettime(CLOCK_MONOTONIC, &end_ns);
+                    kmeans_time_ms[kmeans_algorithm_idx] += ElapsedTimeMs(start_ns, end_ns);
+                }
+                n_mismatches += (centroids[1].features != centroids[0].features) + (centroids[2].features != centroids[0].features);
+                lloyd_sse += KMeansSSE(training_set, samples_by_class[class_idx], centroids[0]);
+                minibatch_sse += KMeansSSE(training_set, samples_by_class[class_idx], centroids[3]);
+                n_runs++;
+            }
+        }
+    }
+
+    std::cout << "kmeans_runs             " << n_runs << std::endl;
+    std::cout << "kmeans_seeding_ms       " << seeding_time_ms[0] / K_FOLD << std::endl;
+    std::cout << "parallel_seeding_ms     " << seeding_time_ms[1] / K_FOLD << std::endl;
+    for(uint32_t kmeans_algorithm_idx = 0; kmeans_algorithm_idx < 4; kmeans_algorithm_idx++){
+        std::cout << "kmeans_" << kmeans_algorithms[kmeans_algorithm_idx] << "_ms" << std::string(10 - kmeans_algorithms[kmeans_algorithm_idx].size(), ' ') 
+                    << kmeans_time_ms[kmeans_algorithm_idx] / K_FOLD << std::endl;
+    }
+    std::cout << "kmeans_mismatches       " << n_mismatches << std::endl;
+    std::cout << "minibatch_relative_sse  " << minibatch_sse / lloyd_sse << std::endl;
+    std::cout << "parallel_relative_sse   " << parallel_seeded_sse / lloyd_sse << std::endl;
+    std::cout << "peak_rss_mb             " << PeakRssMb() << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc < 2){
+        printf("usage: %s <dataset> [tree|split|predict|parse|knn|ann|kmeans]\n", argv[0]);
+        exit(1);
+    }
+    std::string file_path = "../../datasets/" + (std::string)argv[1] + "-5-fold/" + (std::string)argv[1] + "-5-";
+    std::string mode = (argc > 2)? argv[2] : "tree";
+
+    if(mode == "tree"){
+        BenchmarkTreeBuild(file_path);
+    }
+    else if(mode == "split"){
+        BenchmarkSplitAlgorithms(file_path);
+    }
+    else if(mode == "predict"){
+        BenchmarkPrediction(file_path);
+    }
+    else if(mode == "parse"){
+        BenchmarkParse(file_path);
+    }
+    else if(mode == "knn"){
+        BenchmarkKNearestNeighbors(file_path);
+    }
+    else if(mode == "ann"){
+        BenchmarkApproximateNearestNeighbors(file_path);
+    }
+    else if(mode == "kmeans"){
+        BenchmarkKMeans(file_path);
+    }
+    else{
+        printf("./%s:%d: error: unknown benchmark %s\n", __FILE__, __LINE__, mode.c_str());
+        exit(1);
+    }
+}
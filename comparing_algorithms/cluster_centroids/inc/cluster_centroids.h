@@ -1,10 +1,16 @@
 #include<vector>
 #include<algorithm>
+#include<numeric> // std::iota
 #include<cstdint>
 #include<iostream>
+#include<cstring> // memcpy
 #include "./k_means_pp.h"
+#include "../../../inc/thread_pool.h" // GetThreadPool
 
-void ClusterCentroids(std::vector<std::vector<float>> &training_set, 
-                        const uint32_t n_classes, 
-                            const uint32_t max_iters,  
-                                const float tolerance);
\ No newline at end of file
+// Leaves training_set untouched, resampled_set holds every class replaced by as many k-means centroids as the smallest class has samples
+// Classes are clustered in parallel on GetThreadPool(kmeans_parameters.n_threads), the result only depends on gen
+void ClusterCentroids(const DataMatrix &training_set, 
+                        const ClassStatistics &class_statistics, 
+                            const KMeansParameters &kmeans_parameters,
+                                std::mt19937 &gen, 
+                                    DataMatrix &resampled_set);
\ No newline at end of file
@@ -1,7 +1,35 @@
+#ifndef K_MEANS_PP_H
+#define K_MEANS_PP_H
+
 #include <cmath> // sqrt
 #include <vector>
-#include <random> // std::random_device, std::mt19937 gen(), std::uniform_real_distribution<>;
+#include <random> // std::mt19937, std::uniform_int_distribution<>
 #include <limits> // std::numeric_limits<float>::max();
 #include<iostream>
+#include <cstring> // memcpy
+#include <string>
+#include <cstdio>    // printf
+#include <cstdlib>   // exit
+#include <numeric>   // std::iota
+#include <algorithm> // std::min, std::max
+#include "../../../inc/nearest_neighbors.h"
+#include "../../../inc/weighted_sampler.h"
+#include "../../../inc/data_matrix.h"
+
+typedef struct KMeansParameters{
+    uint32_t max_iter;          // Iterations, passes over the samples for "minibatch"
+    float tolerance;            // Stop once an iteration lowers the SSE by no more than this
+    std::string algorithm;      // "lloyd", "hamerly", "auto" (all give the clusters of Lloyd's algorithm) or "minibatch"
+    uint32_t batch_size;        // Samples per step of "minibatch"
+    std::string init_algorithm; // "kmeans++" (D^2 seeding) or "kmeans||" (a few parallel oversampling rounds, for very large datasets)
+    uint32_t n_threads;         // Threads of "kmeans||", 0 means one per hardware thread
+}KMeansParameters;
+
+// k-means of the rows dataset.Row(sample_idxes[...]) seeded by k-means++ or k-means|| with memory linear in the number of samples,
+// returns the centroids of the non-empty clusters, labelled 0
+// "auto" runs Hamerly's algorithm when the clusters are large enough for its bounds to pay off and Lloyd's otherwise,
+// "minibatch" trades exactness for time on datasets larger than a batch and clusters smaller ones like "auto"
+DataMatrix KMeansPP(const DataMatrix &dataset, const std::vector<uint32_t> &sample_idxes, const uint32_t n_clusters, const KMeansParameters &parameters, 
+                        std::mt19937 &gen);
 
-std::vector<std::vector<float>> KMeansPP(std::vector<std::vector<float>> &dataset, uint32_t n_clusters,  uint32_t max_iter, float tolerance);
+#endif // K_MEANS_PP_H
@@ -1,44 +1,52 @@
 #include "../inc/cluster_centroids.h"
-static std::vector<uint32_t> CalculateClassCounts(const std::vector<std::vector<float>> &training_set, 
-                                                    const uint32_t n_classes)
+void ClusterCentroids(const DataMatrix &training_set, 
+                                                    const ClassStatistics &class_statistics, 
+                                                        const KMeansParameters &kmeans_parameters,
+                                                            std::mt19937 &gen, 
+                                                                DataMatrix &resampled_set)
 {
-    std::vector<uint32_t> class_counts((n_classes + 1), 0); 
+    const uint32_t n_classes = class_statistics.class_labels.size();
+    const std::vector<uint32_t> &class_counts = class_statistics.class_counts;
+    const std::vector<std::vector<uint32_t>> &data_idxes_by_class = class_statistics.data_idxes_by_class;
 
-    const uint32_t training_label_idx = training_set[0].size() - 1;
-    for(uint32_t training_data_idx = 0; training_data_idx < training_set.size(); training_data_idx++){   
-        uint32_t training_label = training_set[training_data_idx][training_label_idx];
-        class_counts[training_label]++;
-    }
-
-    return class_counts;
-}
-
-void ClusterCentroids(std::vector<std::vector<float>> &training_set, 
-                                                    const uint32_t n_classes, 
-                                                        const uint32_t max_iters,  
-                                                            const float tolerance)
-{
-    std::vector<uint32_t> class_counts = CalculateClassCounts(training_set, n_classes);
-    
-    std::vector<std::vector<float>> data_idxes_by_class[n_classes + 1];
+    const uint32_t least_minority_sample_size = class_counts[SmallestClass(class_statistics)];
+    // Every class clusters with its own generator, seeded in class order, so the result does not depend on n_threads
+    std::vector<uint32_t> class_seeds(n_classes + 1, 0);
     for(uint32_t class_idx = 1; class_idx <= n_classes; class_idx++){
-        data_idxes_by_class[class_idx].reserve(class_counts[class_idx]);
+        class_seeds[class_idx] = gen();
     }
-
-    const uint32_t label_idx = training_set[0].size() - 1;
-    for(uint32_t data_idx = 0; data_idx < training_set.size(); data_idx++){
-        const uint32_t label = training_set[data_idx][label_idx];
-        data_idxes_by_class[label].push_back(training_set[data_idx]);
+    // Largest classes first, so that the longest jobs do not start last
+    std::vector<uint32_t> class_order(n_classes);
+    std::iota(class_order.begin(), class_order.end(), 1);
+    std::stable_sort(class_order.begin(), class_order.end(), 
+                        [&](uint32_t lhs, uint32_t rhs){return class_counts[lhs] > class_counts[rhs];});
+    std::vector<DataMatrix> centroids_by_class(n_classes + 1);
+    auto cluster_class = [&](uint32_t task_idx){
+        const uint32_t class_idx = class_order[task_idx];
+        std::mt19937 class_gen(class_seeds[class_idx]);
+        centroids_by_class[class_idx] = KMeansPP(training_set, data_idxes_by_class[class_idx], least_minority_sample_size, kmeans_parameters, class_gen);
+    };
+    if(kmeans_parameters.n_threads == 1){
+        for(uint32_t task_idx = 0; task_idx < n_classes; task_idx++){
+            cluster_class(task_idx);
+        }
+    }
+    else{
+        GetThreadPool(kmeans_parameters.n_threads).ParallelFor(n_classes, cluster_class);
     }
-    training_set.clear();
 
-    const uint32_t least_minority_sample_size = *std::min_element(class_counts.begin() + 1, class_counts.end());
+    uint32_t n_centroids = 0;
     for(uint32_t class_idx = 1; class_idx <= n_classes; class_idx++){
-        std::vector<std::vector<float>> centroids = KMeansPP(data_idxes_by_class[class_idx], least_minority_sample_size, max_iters, tolerance);
-        // KMeans centroids have no label
-        for(uint32_t centroid_idx = 0; centroid_idx < centroids.size(); centroid_idx++){
-            centroids[centroid_idx].push_back(class_idx);
+        n_centroids += centroids_by_class[class_idx].n_samples;
+    }
+    InitDataMatrix(resampled_set, n_centroids, training_set.n_features);
+    uint32_t resampled_idx = 0;
+    for(uint32_t class_idx = 1; class_idx <= n_classes; class_idx++){
+        const DataMatrix &centroids = centroids_by_class[class_idx];
+        // KMeans centroids have no label, they take the one of their class
+        for(uint32_t centroid_idx = 0; centroid_idx < centroids.n_samples; centroid_idx++, resampled_idx++){
+            memcpy(resampled_set.Row(resampled_idx), centroids.Row(centroid_idx), centroids.stride * sizeof(float));
+            resampled_set.labels[resampled_idx] = class_idx;
         }
-        training_set.insert(training_set.end(), centroids.begin(), centroids.end());
     }
-}
\ No newline at end of file
+}
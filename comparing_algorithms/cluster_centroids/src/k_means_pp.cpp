@@ -1,140 +1,400 @@
 #include "../inc/k_means_pp.h"
 
-static float EuclideanDistance(std::vector<float> &src, std::vector<float> &dst)
-{
-    const uint32_t n_dimension = src.size() - 1;
-    float square_distance = 0;
+#define BOUND_SLACK 1e-4                 // Relative margin on every triangle inequality test, covers the rounding of float distances
+#define HAMERLY_MIN_CLUSTER_SIZE 32      // "auto" runs Hamerly's algorithm from this many samples per cluster on, Lloyd's below
+#define MINI_BATCH_MAX_NO_IMPROVEMENT 10 // Mini-batch k-means stops after this many steps without a lower smoothed batch SSE
+#define KMEANS_PARALLEL_ROUNDS 5         // Oversampling rounds of k-means|| seeding
 
-    // the last column of vector stores the label, so we skip it
-    for(uint32_t dim_idx = 0; dim_idx < n_dimension; dim_idx++)
-    {
-        float diff = src[dim_idx] - dst[dim_idx];
-        square_distance += diff * diff;
+// The points points.Point(subset_idxes[...]), read in place through row_idxes
+static PointSet SelectPoints(const PointSet &points, const std::vector<uint32_t> &subset_idxes, std::vector<uint32_t> &row_idxes)
+{
+    row_idxes.resize(subset_idxes.size());
+    for(uint32_t subset_idx = 0; subset_idx < subset_idxes.size(); subset_idx++){
+        row_idxes[subset_idx] = (points.idxes == NULL)? subset_idxes[subset_idx] : points.idxes[subset_idxes[subset_idx]];
     }
+    return {points.rows, points.stride, row_idxes.data(), (uint32_t)row_idxes.size(), points.n_features};
+}
 
-    return sqrt(square_distance);
+// Lower min_square_distances[i] to the squared distance from sample i to centroid, 
+// points_by_feature is n_features x n_samples so the loop over samples is vectorized
+static void UpdateMinSquareDistances(const std::vector<float> &points_by_feature, const uint32_t n_samples, const uint32_t n_features, 
+                                        const float *centroid, std::vector<float> &square_distances, std::vector<float> &min_square_distances)
+{
+    std::fill(square_distances.begin(), square_distances.end(), 0.f);
+    for(uint32_t feature_idx = 0; feature_idx < n_features; feature_idx++){
+        const float centroid_feature = centroid[feature_idx];
+        const float *sample_features = &points_by_feature[(size_t)feature_idx * n_samples];
+        for(uint32_t data_idx = 0; data_idx < n_samples; data_idx++){
+            float diff = sample_features[data_idx] - centroid_feature;
+            square_distances[data_idx] += diff * diff;
+        }
+    }
+    for(uint32_t data_idx = 0; data_idx < n_samples; data_idx++){
+        min_square_distances[data_idx] = std::min(min_square_distances[data_idx], square_distances[data_idx]);
+    }
 }
 
-static uint32_t RouletteWheelSelection(std::vector<float> fitnesses)
+// k-means++ (D^2) seeding: after a first pick, every seed is a sample drawn with probability proportional to its weight
+// times its squared distance to the nearest seed so far. Only that distance is kept per sample, updated against the newest seed.
+// Without sample_weights every weight is 1 and the first pick is uniform, with them the first pick follows the weights.
+static void SeedKMeansPP(const PointSet &points, const std::vector<float> *sample_weights, const uint32_t n_seeds, std::mt19937 &gen, 
+                            std::vector<uint32_t> &seed_idxes)
 {
-    float total_fitness = std::accumulate(fitnesses.begin(), fitnesses.end(), 0.f);
+    const uint32_t n_samples = points.n_points, n_features = points.n_features;
+    std::vector<float> points_by_feature((size_t)n_features * n_samples);
+    for(uint32_t data_idx = 0; data_idx < n_samples; data_idx++){
+        const float *point = points.Point(data_idx);
+        for(uint32_t feature_idx = 0; feature_idx < n_features; feature_idx++){
+            points_by_feature[(size_t)feature_idx * n_samples + data_idx] = point[feature_idx];
+        }
+    }
 
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<> distrib(0.0, total_fitness);
+    std::uniform_int_distribution<> distrib(0, n_samples - 1);
+    seed_idxes.assign(1, (sample_weights == NULL)? distrib(gen) : WeightedSampler(*sample_weights).Draw(gen));
+    std::vector<float> square_distances(n_samples);
+    std::vector<float> min_square_distances(n_samples, std::numeric_limits<float>::infinity());
+    std::vector<float> fitnesses(n_samples);
+    while(seed_idxes.size() < n_seeds){
+        UpdateMinSquareDistances(points_by_feature, n_samples, n_features, points.Point(seed_idxes.back()), square_distances, min_square_distances);
+        for(uint32_t data_idx = 0; data_idx < n_samples; data_idx++){
+            fitnesses[data_idx] = (sample_weights == NULL)? min_square_distances[data_idx] : min_square_distances[data_idx] * (*sample_weights)[data_idx];
+        }
 
-    float random_value = distrib(gen);
-    for(uint32_t fitness_idx = 0; fitness_idx < fitnesses.size(); fitness_idx++){
-        random_value -= fitnesses[fitness_idx];
-        if(random_value <= 0.f){
-            return fitness_idx;
+        // Every sample coincides with a seed when all fitnesses are 0, then any of them will do
+        WeightedSampler sampler(fitnesses);
+        seed_idxes.push_back((sampler.TotalWeight() > 0.0)? sampler.Draw(gen) : distrib(gen));
+    }
+}
+
+// k-means|| (Bahmani et al.): starting from one uniform pick, each of KMEANS_PARALLEL_ROUNDS rounds keeps every sample
+// independently with probability 2 x n_clusters x its squared distance to the nearest candidate / the total of those distances.
+// The candidates are then weighted by the samples nearest to them and reduced to n_clusters seeds by weighted k-means++.
+// The distances to new candidates and the weights come from FindKNearestNeighbors on n_threads threads.
+static void SeedKMeansParallel(const PointSet &points, const uint32_t n_clusters, const uint32_t n_threads, std::mt19937 &gen, 
+                                std::vector<uint32_t> &seed_idxes)
+{
+    const uint32_t n_samples = points.n_points;
+    std::uniform_int_distribution<> distrib(0, n_samples - 1);
+    std::uniform_real_distribution<double> unit_distrib(0.0, 1.0);
+    std::vector<uint32_t> candidate_idxes(1, distrib(gen));
+    std::vector<uint32_t> new_candidate_idxes = candidate_idxes;
+    std::vector<float> min_square_distances(n_samples, std::numeric_limits<float>::infinity());
+    std::vector<uint32_t> ks(n_samples, 1);
+    std::vector<uint32_t> candidate_rows;
+    for(uint32_t round = 0; round < KMEANS_PARALLEL_ROUNDS || candidate_idxes.size() < n_clusters; round++){
+        NeighborLists nearest_candidates;
+        FindKNearestNeighbors(SelectPoints(points, new_candidate_idxes, candidate_rows), points, ks.data(), n_threads, nearest_candidates);
+        double cost = 0;
+        for(uint32_t data_idx = 0; data_idx < n_samples; data_idx++){
+            min_square_distances[data_idx] = std::min(min_square_distances[data_idx], nearest_candidates.distances[data_idx] * nearest_candidates.distances[data_idx]);
+            cost += min_square_distances[data_idx];
+        }
+        // Every sample coincides with a candidate, the remaining ones are any samples
+        if(cost == 0){
+            while(candidate_idxes.size() < n_clusters){
+                candidate_idxes.push_back(distrib(gen));
+            }
+            break;
+        }
+
+        new_candidate_idxes.clear();
+        const double oversampling = 2.0 * n_clusters / cost;
+        for(uint32_t data_idx = 0; data_idx < n_samples; data_idx++){
+            if(unit_distrib(gen) < oversampling * min_square_distances[data_idx]){
+                new_candidate_idxes.push_back(data_idx);
+            }
         }
+        candidate_idxes.insert(candidate_idxes.end(), new_candidate_idxes.begin(), new_candidate_idxes.end());
+    }
+    if(candidate_idxes.size() == n_clusters){
+        seed_idxes = candidate_idxes;
+        return;
     }
 
-    return fitnesses.size() - 1;
+    const PointSet candidate_points = SelectPoints(points, candidate_idxes, candidate_rows);
+    NeighborLists nearest_candidates;
+    FindKNearestNeighbors(candidate_points, points, ks.data(), n_threads, nearest_candidates);
+    std::vector<float> candidate_weights(candidate_idxes.size(), 0.f);
+    for(uint32_t data_idx = 0; data_idx < n_samples; data_idx++){
+        candidate_weights[nearest_candidates.idxes[data_idx]]++;
+    }
+    std::vector<uint32_t> candidate_seed_idxes;
+    SeedKMeansPP(candidate_points, &candidate_weights, n_clusters, gen, candidate_seed_idxes);
+    seed_idxes.resize(n_clusters);
+    for(uint32_t seed_idx = 0; seed_idx < n_clusters; seed_idx++){
+        seed_idxes[seed_idx] = candidate_idxes[candidate_seed_idxes[seed_idx]];
+    }
 }
 
-static void SelectInitCentroids(std::vector<std::vector<float>> &training_set, uint32_t n_clusters, std::vector<std::vector<float>> &init_centroids)
+// Same order of additions as FindKNearestNeighbors, so every algorithm picks the centroid Lloyd's algorithm picks
+static float SquareDistance(const float *src, const float *dst, const uint32_t n_features)
 {
-    const uint32_t n_features = training_set[0].size() - 1;
-    
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> distrib(0, training_set.size() - 1);
-
-    // KMeansPP select only existing data as initial centroids
-    std::vector<uint32_t> init_centroids_idx(n_clusters); 
+    float square_distance = 0.f;
+    for(uint32_t feature_idx = 0; feature_idx < n_features; feature_idx++){
+        float diff = src[feature_idx] - dst[feature_idx];
+        square_distance += diff * diff;
+    }
+    return square_distance;
+}
 
-    init_centroids_idx[0] = distrib(gen); // Random select first centroid
-    init_centroids.reserve(n_clusters);
-    init_centroids.push_back(training_set[init_centroids_idx[0]]);
+// The centroids of live_clusters, row-major in the order of live_clusters
+static void GatherCentroids(const std::vector<float> &centroids, const std::vector<uint32_t> &live_clusters, const uint32_t n_features, 
+                                std::vector<float> &live_centroids)
+{
+    live_centroids.resize(live_clusters.size() * n_features);
+    for(uint32_t live_idx = 0; live_idx < live_clusters.size(); live_idx++){
+        memcpy(&live_centroids[(size_t)live_idx * n_features], &centroids[(size_t)live_clusters[live_idx] * n_features], n_features * sizeof(float));
+    }
+}
 
-    std::vector<std::vector<float>> distance(training_set.size(), std::vector<float>(training_set.size()));
-    for(uint32_t src_idx = 0; src_idx < training_set.size(); src_idx++){
-        distance[src_idx][src_idx] = 0;
-        for(uint32_t dst_idx = (src_idx + 1); dst_idx < training_set.size(); dst_idx++){
-            float dist = EuclideanDistance(training_set[src_idx], training_set[dst_idx]);
-            distance[src_idx][dst_idx] = dist;
-            distance[dst_idx][src_idx] = dist;
-        }
+// Lloyd's algorithm: the nearest live centroid of every sample from a full search
+static void AssignLloyd(const PointSet &points, const std::vector<float> &live_centroids, const std::vector<uint32_t> &live_clusters, 
+                            std::vector<uint32_t> &labels, std::vector<float> &distances)
+{
+    const uint32_t n_samples = points.n_points;
+    std::vector<uint32_t> ks(n_samples, 1);
+    NeighborLists nearest_centroids;
+    FindKNearestNeighbors(PackedPoints(live_centroids.data(), live_clusters.size(), points.n_features), points, ks.data(), 1, nearest_centroids);
+    for(uint32_t data_idx = 0; data_idx < n_samples; data_idx++){
+        labels[data_idx]    = live_clusters[nearest_centroids.idxes[data_idx]];
+        distances[data_idx] = nearest_centroids.distances[data_idx];
     }
+}
 
-    for(uint32_t centroid_idx = 1; centroid_idx < n_clusters; centroid_idx++){
-        std::vector<float> fitnesses(training_set.size(), 0.f);
-        for(uint32_t training_data_idx = 0; training_data_idx < training_set.size(); training_data_idx++){
-            for(uint32_t _centroid_idx = 0; _centroid_idx < centroid_idx; _centroid_idx++){
-                uint32_t dst_idx = init_centroids_idx[_centroid_idx];
-                // set distance from src to selected centroids as fitness
-                fitnesses[training_data_idx] += distance[training_data_idx][dst_idx];   
+// Hamerly's algorithm: a sample keeps its centroid without a search while its distance to it is below both the lower bound
+// on its distance to every other centroid and half the distance from its centroid to the nearest other one.
+// The remaining samples look up their two nearest centroids in one batch, the second one renews the lower bound.
+static void AssignHamerly(const PointSet &points, const std::vector<float> &centroids, const std::vector<float> &live_centroids, 
+                            const std::vector<uint32_t> &live_clusters, std::vector<double> &lower_bounds, std::vector<uint32_t> &labels, 
+                            std::vector<float> &distances)
+{
+    const uint32_t n_samples = points.n_points, n_features = points.n_features;
+    const uint32_t n_live_clusters = live_clusters.size();
+    const PointSet live_centroid_points = PackedPoints(live_centroids.data(), n_live_clusters, n_features);
+    std::vector<uint32_t> ks(std::max(n_samples, n_live_clusters), 2);
+    NeighborLists nearest_centroids;
+    FindKNearestNeighbors(live_centroid_points, live_centroid_points, ks.data(), 1, nearest_centroids);
+    std::vector<double> half_gaps(centroids.size() / n_features, std::numeric_limits<double>::infinity());
+    for(uint32_t live_idx = 0; live_idx < n_live_clusters; live_idx++){
+        for(uint32_t neighbor_idx = nearest_centroids.offsets[live_idx]; neighbor_idx < nearest_centroids.offsets[live_idx + 1]; neighbor_idx++){
+            if(nearest_centroids.idxes[neighbor_idx] != live_idx){
+                half_gaps[live_clusters[live_idx]] = std::min(half_gaps[live_clusters[live_idx]], (double)nearest_centroids.distances[neighbor_idx] / 2);
             }
         }
+    }
 
-        uint32_t selected_idx = RouletteWheelSelection(fitnesses);
+    std::vector<uint32_t> searched_idxes;
+    for(uint32_t data_idx = 0; data_idx < n_samples; data_idx++){
+        const float *point = points.Point(data_idx);
+        const uint32_t label = labels[data_idx];
+        float square_distance = SquareDistance(point, &centroids[(size_t)label * n_features], n_features);
+        if(sqrt((double)square_distance) * (1 + BOUND_SLACK) < std::max(half_gaps[label], lower_bounds[data_idx])){
+            distances[data_idx] = sqrt(square_distance);
+        }
+        else{
+            searched_idxes.push_back(data_idx);
+        }
+    }
+    if(searched_idxes.empty()){
+        return;
+    }
 
-        init_centroids_idx[centroid_idx] = selected_idx;
-        init_centroids.push_back(training_set[init_centroids_idx[centroid_idx]]);
+    std::vector<uint32_t> searched_rows;
+    FindKNearestNeighbors(live_centroid_points, SelectPoints(points, searched_idxes, searched_rows), ks.data(), 1, nearest_centroids);
+    for(uint32_t searched_idx = 0; searched_idx < searched_idxes.size(); searched_idx++){
+        const uint32_t data_idx = searched_idxes[searched_idx];
+        const uint32_t begin = nearest_centroids.offsets[searched_idx];
+        labels[data_idx]       = live_clusters[nearest_centroids.idxes[begin]];
+        distances[data_idx]    = nearest_centroids.distances[begin];
+        lower_bounds[data_idx] = (nearest_centroids.offsets[searched_idx + 1] - begin > 1)? 
+                                    (double)nearest_centroids.distances[begin + 1] : std::numeric_limits<double>::infinity();
     }
 }
 
-std::vector<std::vector<float>> KMeansPP(std::vector<std::vector<float>> &training_set, const uint32_t n_clusters,  const uint32_t max_iter, const float tolerance)
+// Sculley's mini-batch k-means: every step assigns batch_size random samples and moves each of their centroids towards them
+// by one over the number of samples it has taken so far. Centroids start at samples and never empty.
+static void MiniBatchKMeans(const PointSet &points, std::vector<float> &centroids, const uint32_t n_clusters, const KMeansParameters &parameters, 
+                                std::mt19937 &gen)
 {
-    const uint32_t n_features = training_set[0].size() - 1; // without label
-    uint32_t n_iter = 0;
+    const uint32_t n_samples = points.n_points, n_features = points.n_features;
+    std::uniform_int_distribution<uint32_t> distrib(0, n_samples - 1);
+    const uint32_t batch_size = parameters.batch_size;
+    const uint64_t max_steps = (uint64_t)parameters.max_iter * ((n_samples + batch_size - 1) / batch_size);
+    const double smoothing = std::min(1.0, 2.0 * batch_size / (n_samples + 1));
 
-    std::vector<uint32_t> label(training_set.size(), 0);
+    std::vector<uint32_t> batch_idxes(batch_size), batch_rows;
+    std::vector<uint32_t> ks(batch_size, 1);
     std::vector<uint32_t> cluster_counts(n_clusters, 0);
+    double smoothed_SSE = 0, best_smoothed_SSE = std::numeric_limits<double>::infinity();
+    uint32_t n_no_improvement = 0;
+    for(uint64_t step = 0; step < max_steps; step++){
+        for(uint32_t batch_idx = 0; batch_idx < batch_size; batch_idx++){
+            batch_idxes[batch_idx] = distrib(gen);
+        }
+        const PointSet batch_points = SelectPoints(points, batch_idxes, batch_rows);
+        NeighborLists nearest_centroids;
+        FindKNearestNeighbors(PackedPoints(centroids.data(), n_clusters, n_features), batch_points, ks.data(), 1, nearest_centroids);
 
-    float previous_SSE = 0, current_SSE = std::numeric_limits<float>::max();
+        double batch_SSE = 0;
+        for(uint32_t batch_idx = 0; batch_idx < batch_size; batch_idx++){
+            const uint32_t cluster_idx = nearest_centroids.idxes[batch_idx];
+            batch_SSE += (double)nearest_centroids.distances[batch_idx] * nearest_centroids.distances[batch_idx];
+            const float learning_rate = 1.f / ++cluster_counts[cluster_idx];
+            float *centroid = &centroids[(size_t)cluster_idx * n_features];
+            const float *point = batch_points.Point(batch_idx);
+            for(uint32_t feature_idx = 0; feature_idx < n_features; feature_idx++){
+                centroid[feature_idx] += learning_rate * (point[feature_idx] - centroid[feature_idx]);
+            }
+        }
 
-    std::vector<std::vector<float>> centroids;
-    SelectInitCentroids(training_set, n_clusters, centroids);
+        // Stop once the batch SSE, smoothed over about two passes of the batches, stops falling
+        batch_SSE /= batch_size;
+        smoothed_SSE = (step == 0)? batch_SSE : smoothed_SSE * (1 - smoothing) + batch_SSE * smoothing;
+        if(smoothed_SSE < best_smoothed_SSE){
+            best_smoothed_SSE = smoothed_SSE;
+            n_no_improvement = 0;
+        }
+        else if(++n_no_improvement >= MINI_BATCH_MAX_NO_IMPROVEMENT){
+            break;
+        }
+    }
+}
 
-    do{
-        previous_SSE = current_SSE;
-        current_SSE  = 0;
+DataMatrix KMeansPP(const DataMatrix &dataset, const std::vector<uint32_t> &sample_idxes, const uint32_t n_clusters, const KMeansParameters &parameters, 
+                        std::mt19937 &gen)
+{
+    const uint32_t n_samples  = sample_idxes.size();
+    const uint32_t n_features = dataset.n_features;
 
-        cluster_counts.assign(cluster_counts.size(), 0.f);
-        for(uint32_t data_idx = 0; data_idx < training_set.size(); data_idx++){
-            uint32_t nearest_centroid_idx = 0;
-            float distance_to_nearest_centroid = std::numeric_limits<float>::max();
+    std::string algorithm = parameters.algorithm;
+    if(algorithm != "lloyd" && algorithm != "hamerly" && algorithm != "auto" && algorithm != "minibatch"){
+        printf("./%s:%d: error: unknown k-means algorithm %s\n", __FILE__, __LINE__, algorithm.c_str());
+        exit(1);
+    }
+    if(parameters.init_algorithm != "kmeans++" && parameters.init_algorithm != "kmeans||"){
+        printf("./%s:%d: error: unknown k-means seeding %s\n", __FILE__, __LINE__, parameters.init_algorithm.c_str());
+        exit(1);
+    }
+    // With no more samples than a batch, mini-batch k-means would be Lloyd's algorithm with extra noise
+    if(algorithm == "minibatch" && n_samples <= parameters.batch_size){
+        algorithm = "auto";
+    }
+    // Small clusters keep few samples inside Hamerly's bounds, then its bookkeeping costs more than it saves
+    if(algorithm == "auto"){
+        algorithm = (n_samples >= (uint64_t)HAMERLY_MIN_CLUSTER_SIZE * n_clusters)? "hamerly" : "lloyd";
+    }
+
+    const PointSet points = MatrixPoints(dataset, &sample_idxes);
+    // KMeansPP select only existing data as initial centroids
+    std::vector<uint32_t> seed_idxes;
+    if(parameters.init_algorithm == "kmeans||"){
+        SeedKMeansParallel(points, n_clusters, parameters.n_threads, gen, seed_idxes);
+    }
+    else{
+        SeedKMeansPP(points, NULL, n_clusters, gen, seed_idxes);
+    }
+    std::vector<float> centroids((size_t)n_clusters * n_features);
+    for(uint32_t cluster_idx = 0; cluster_idx < n_clusters; cluster_idx++){
+        memcpy(&centroids[(size_t)cluster_idx * n_features], points.Point(seed_idxes[cluster_idx]), n_features * sizeof(float));
+    }
+
+    std::vector<uint32_t> labels(n_samples, 0);
+    std::vector<float> distances(n_samples);
+    std::vector<uint32_t> cluster_counts(n_clusters, 1);
+    if(algorithm == "minibatch"){
+        MiniBatchKMeans(points, centroids, n_clusters, parameters, gen);
+        // Centroids that are no sample's nearest one are dropped like the empty clusters of Lloyd's algorithm
+        std::vector<uint32_t> all_clusters(n_clusters);
+        std::iota(all_clusters.begin(), all_clusters.end(), 0);
+        AssignLloyd(points, centroids, all_clusters, labels, distances);
+        cluster_counts.assign(n_clusters, 0);
+        for(uint32_t data_idx = 0; data_idx < n_samples; data_idx++){
+            cluster_counts[labels[data_idx]]++;
+        }
+    }
+    else{
+        // Hamerly's lower bounds start at 0, and every sample is measured against its own centroid in every iteration,
+        // so it produces the labels, SSE and centroids of Lloyd's algorithm
+        std::vector<double> lower_bounds((algorithm == "hamerly")? n_samples : 0, 0.0);
+        std::vector<float> previous_centroids, live_centroids;
+        std::vector<uint32_t> live_clusters;
+        uint32_t n_iter = 0;
+        float previous_SSE = 0, current_SSE = std::numeric_limits<float>::max();
+        do{
+            previous_SSE = current_SSE;
+            current_SSE  = 0;
+
+            // Empty clusters left NaN centroids behind, they are never the nearest one
+            live_clusters.clear();
             for(uint32_t cluster_idx = 0; cluster_idx < n_clusters; cluster_idx++){
-                float distance_to_centroid = EuclideanDistance(training_set[data_idx], centroids[cluster_idx]);
-                if(distance_to_centroid < distance_to_nearest_centroid){
-                    nearest_centroid_idx         = cluster_idx;
-                    distance_to_nearest_centroid = distance_to_centroid;
+                if(cluster_counts[cluster_idx] > 0){
+                    live_clusters.push_back(cluster_idx);
                 }
             }
-            label[data_idx] = nearest_centroid_idx;
-            current_SSE += distance_to_nearest_centroid * distance_to_nearest_centroid;
-        }
+            GatherCentroids(centroids, live_clusters, n_features, live_centroids);
+            if(algorithm == "lloyd"){
+                AssignLloyd(points, live_centroids, live_clusters, labels, distances);
+            }
+            else{
+                AssignHamerly(points, centroids, live_centroids, live_clusters, lower_bounds, labels, distances);
+            }
+            for(uint32_t data_idx = 0; data_idx < n_samples; data_idx++){
+                current_SSE += distances[data_idx] * distances[data_idx];
+            }
 
-        centroids.assign(n_clusters, std::vector<float>(n_features, 0.f));
-        for(uint32_t data_idx = 0; data_idx < training_set.size(); data_idx++){  
-            cluster_counts[label[data_idx]]++;
-            for(uint32_t feature_idx = 0; feature_idx < n_features; feature_idx++){
-                centroids[label[data_idx]][feature_idx] += training_set[data_idx][feature_idx];
+            previous_centroids.swap(centroids);
+            centroids.assign((size_t)n_clusters * n_features, 0.f);
+            cluster_counts.assign(n_clusters, 0);
+            for(uint32_t data_idx = 0; data_idx < n_samples; data_idx++){  
+                cluster_counts[labels[data_idx]]++;
+                const float *point = points.Point(data_idx);
+                for(uint32_t feature_idx = 0; feature_idx < n_features; feature_idx++){
+                    centroids[(size_t)labels[data_idx] * n_features + feature_idx] += point[feature_idx];
+                }
+            }
+            for(uint32_t centroid_idx = 0; centroid_idx < n_clusters; centroid_idx++){  
+                for(uint32_t feature_idx = 0; feature_idx < n_features; feature_idx++){
+                    centroids[(size_t)centroid_idx * n_features + feature_idx] /= cluster_counts[centroid_idx];
+                }
             }
-        }
 
-        for(uint32_t centroid_idx = 0; centroid_idx < n_clusters; centroid_idx++){  
-            for(uint32_t feature_idx = 0; feature_idx < n_features; feature_idx++){
-                centroids[centroid_idx][feature_idx] /= cluster_counts[centroid_idx];
+            // A lower bound falls by the farthest move of any centroid other than the sample's own
+            if(algorithm == "hamerly"){
+                std::vector<double> drifts(n_clusters, 0.0);
+                uint32_t farthest_cluster = 0;
+                for(uint32_t cluster_idx = 0; cluster_idx < n_clusters; cluster_idx++){
+                    if(cluster_counts[cluster_idx] > 0){
+                        drifts[cluster_idx] = sqrt((double)SquareDistance(&centroids[(size_t)cluster_idx * n_features], 
+                                                                            &previous_centroids[(size_t)cluster_idx * n_features], n_features));
+                        farthest_cluster = (drifts[cluster_idx] > drifts[farthest_cluster])? cluster_idx : farthest_cluster;
+                    }
+                }
+                double second_farthest_drift = 0;
+                for(uint32_t cluster_idx = 0; cluster_idx < n_clusters; cluster_idx++){
+                    if(cluster_idx != farthest_cluster){
+                        second_farthest_drift = std::max(second_farthest_drift, drifts[cluster_idx]);
+                    }
+                }
+                for(uint32_t data_idx = 0; data_idx < n_samples; data_idx++){
+                    lower_bounds[data_idx] -= (labels[data_idx] == farthest_cluster)? second_farthest_drift : drifts[farthest_cluster];
+                }
             }
-        }
 
-        if(++n_iter > max_iter){
-            break;
+            if(++n_iter > parameters.max_iter){
+                break;
+            }
         }
+        while(previous_SSE - current_SSE > parameters.tolerance);
     }
-    while(previous_SSE - current_SSE > tolerance);
 
-    for(int centroid_idx = centroids.size() - 1; centroid_idx >= 0; centroid_idx--){
-        if(std::isnan(centroids[centroid_idx][0])){
-            centroids.erase(centroids.begin() + centroid_idx);
+    // KMeans centroids have no label
+    DataMatrix result_centroids;
+    InitDataMatrix(result_centroids, 0, n_features);
+    for(uint32_t cluster_idx = 0; cluster_idx < n_clusters; cluster_idx++){
+        if(cluster_counts[cluster_idx] > 0){
+            AppendRow(result_centroids, &centroids[(size_t)cluster_idx * n_features], 0);
         }
     }
 
-    return centroids;
+    return result_centroids;
 }
-
-
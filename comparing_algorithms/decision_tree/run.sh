@@ -31,6 +31,10 @@ TEST_TIME=22
 MODEL_TYPE="decision_tree"
 MIN_SAMPLES_SPLIT=10
 MAX_PURITY=0.95
+SPLIT_ALGORITHM="exact"
+N_THREADS=1
+N_JOBS=0
+DISK_CACHE=1
 
 CMAKE_OPTIONS="
     -DK_FOLD=${K_FOLD}
@@ -38,6 +42,10 @@ CMAKE_OPTIONS="
     -DMODEL_TYPE="${MODEL_TYPE}"
     -DMIN_SAMPLES_SPLIT=${MIN_SAMPLES_SPLIT}
     -DMAX_PURITY=${MAX_PURITY}
+    -DSPLIT_ALGORITHM="${SPLIT_ALGORITHM}"
+    -DN_THREADS=${N_THREADS}
+    -DN_JOBS=${N_JOBS}
+    -DDISK_CACHE=${DISK_CACHE}
 "
 cd build
 cmake $CMAKE_OPTIONS ..
@@ -47,12 +55,9 @@ filename="../experiments/experiment.txt"
 >"$filename"
 
 echo "Start: $(date +"%Y-%m-%d %H:%M:%S")" >> "$filename"
-echo -e "K_FOLD=$K_FOLD\nTEST_TIME=$TEST_TIME\nMODEL_TYPE=$MODEL_TYPE\nMIN_SAMPLES_SPLIT=$MIN_SAMPLES_SPLIT\nMAX_PURITY=$MAX_PURITY" >> "$filename"
+echo -e "K_FOLD=$K_FOLD\nTEST_TIME=$TEST_TIME\nMODEL_TYPE=$MODEL_TYPE\nMIN_SAMPLES_SPLIT=$MIN_SAMPLES_SPLIT\nMAX_PURITY=$MAX_PURITY\nSPLIT_ALGORITHM=$SPLIT_ALGORITHM\nN_THREADS=$N_THREADS\nN_JOBS=$N_JOBS\nDISK_CACHE=$DISK_CACHE" >> "$filename"
 
-for file in "${file_array[@]}"
-do
-    echo "========== $file ===========" >> "$filename"
-    nohup ./main "$file" >> "$filename" 2> /dev/null &
-    wait $!
-done
+# One process runs every dataset and prints "========== <dataset> ===========" before the results of each
+nohup ./main "${file_array[@]}" >> "$filename" 2> /dev/null &
+wait $!
 echo "Finish: $(date +"%Y-%m-%d %H:%M:%S")" >> "$filename"
\ No newline at end of file
@@ -4,11 +4,15 @@
 #include <cmath>
 #include <vector>
 #include <cstdint>
-#include <queue>
+#include <cstring> // memcpy
 #include <utility> // std::pair
 #include <algorithm>
 #include <iostream>
+#include "../../../inc/nearest_neighbors.h"
+#include "../../../inc/data_matrix.h"
 
-void EditedNearestNeighbors(std::vector<std::vector<float>> &training_set, const uint32_t n_classes, const uint32_t k);
+// Leaves training_set untouched, the increasing indexes of the samples it keeps are returned in selected_idxes
+void EditedNearestNeighbors(const DataMatrix &training_set, const ClassStatistics &class_statistics, const uint32_t k, const NeighborSearchParameters neighbor_search_parameters, 
+                                std::vector<uint32_t> &selected_idxes);
 
 #endif
\ No newline at end of file
@@ -31,6 +31,12 @@ TEST_TIME=22
 MODEL_TYPE="decision_tree"
 MIN_SAMPLES_SPLIT=10
 MAX_PURITY=0.95
+SPLIT_ALGORITHM="exact"
+N_THREADS=1
+N_JOBS=0
+KNN_ALGORITHM="exact"
+RP_TREES=8
+DISK_CACHE=1
 
 for KNN in 1
 do
@@ -41,6 +47,12 @@ do
         -DMODEL_TYPE="${MODEL_TYPE}"
         -DMIN_SAMPLES_SPLIT=${MIN_SAMPLES_SPLIT}
         -DMAX_PURITY=${MAX_PURITY}
+    -DSPLIT_ALGORITHM="${SPLIT_ALGORITHM}"
+    -DN_THREADS=${N_THREADS}
+    -DN_JOBS=${N_JOBS}
+    -DKNN_ALGORITHM="${KNN_ALGORITHM}"
+    -DRP_TREES=${RP_TREES}
+    -DDISK_CACHE=${DISK_CACHE}
     "
     cd build
     cmake $CMAKE_OPTIONS ..
@@ -50,16 +62,11 @@ do
     # >"$filename"
 
     # echo "Start: $(date +"%Y-%m-%d %H:%M:%S")" >> "$filename"
-    # echo -e "KNN=$KNN\nK_FOLD=$K_FOLD\nTEST_TIME=$TEST_TIME\nMODEL_TYPE=$MODEL_TYPE\nMIN_SAMPLES_SPLIT=$MIN_SAMPLES_SPLIT\nMAX_PURITY=$MAX_PURITY" >> "$filename"
+    # echo -e "KNN=$KNN\nK_FOLD=$K_FOLD\nTEST_TIME=$TEST_TIME\nMODEL_TYPE=$MODEL_TYPE\nMIN_SAMPLES_SPLIT=$MIN_SAMPLES_SPLIT\nMAX_PURITY=$MAX_PURITY\nSPLIT_ALGORITHM=$SPLIT_ALGORITHM\nN_THREADS=$N_THREADS\nN_JOBS=$N_JOBS\nKNN_ALGORITHM=$KNN_ALGORITHM\nRP_TREES=$RP_TREES\nDISK_CACHE=$DISK_CACHE" >> "$filename"
 
-    for file in "${file_array[@]}"
-    do
-        # echo "========== $file ===========" >> "$filename"
-        # nohup ./main "$file" >> "$filename" 2> /dev/null &
-        echo "========== $file ==========="
-        ./main "$file"
-        wait $!
-    done
+    # One process runs every dataset and prints "========== <dataset> ===========" before the results of each
+    # nohup ./main "${file_array[@]}" >> "$filename" 2> /dev/null &
+    ./main "${file_array[@]}"
 
     # echo "Finish: $(date +"%Y-%m-%d %H:%M:%S")" >> "$filename"
     cd ..
@@ -1,12 +1,16 @@
 #ifndef RANDOM_UNDER_SAMPLING_H
 #define RANDOM_UNDER_SAMPLING_H
 
-#include <random>    // std::default_random_engine
-#include <chrono>    // std::chrono  
-#include <algorithm> // shuffle
+#include <random>    // std::mt19937, std::uniform_int_distribution
+#include <limits>    // std::numeric_limits
+#include <algorithm> // std::swap
 #include <iostream>
 #include "./file_operations.h"
+#include "./thread_pool.h"
 
-void RandomUnderSampling(std::vector<std::vector<float>> &training_set, const uint32_t n_classes);
+// Leaves training_set untouched, the increasing indexes of the samples it keeps are returned in selected_idxes
+// Classes are sampled in parallel on GetThreadPool(n_threads), the result only depends on gen
+void RandomUnderSampling(const DataMatrix &training_set, const ClassStatistics &class_statistics, const uint32_t n_threads, 
+                            std::mt19937 &gen, std::vector<uint32_t> &selected_idxes);
 
 #endif
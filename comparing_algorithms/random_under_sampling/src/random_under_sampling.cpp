@@ -1,49 +1,48 @@
 #include "../inc/random_under_sampling.h"
 
-static uint32_t CalculateSamplingSize(const std::vector<uint32_t> &class_counts)
+// Moves sampling_size uniformly drawn indexes, in random order, to the front of data_idxes (partial Fisher-Yates shuffle)
+static void PartialShuffle(std::vector<uint32_t> &data_idxes, const uint32_t sampling_size, std::mt19937 &gen)
 {
-    uint32_t smallest_class_count = std::numeric_limits<uint32_t>::max();
-    for(uint32_t class_idx = 1; class_idx < class_counts.size(); class_idx++){
-        if(smallest_class_count > class_counts[class_idx]){
-            smallest_class_count = class_counts[class_idx];
-        }
+    for(uint32_t shuffle_data_idx = 0; shuffle_data_idx < sampling_size; shuffle_data_idx++){
+        std::uniform_int_distribution<uint32_t> distrib(shuffle_data_idx, data_idxes.size() - 1);
+        std::swap(data_idxes[shuffle_data_idx], data_idxes[distrib(gen)]);
     }
-
-    return smallest_class_count;
 }
 
-void RandomUnderSampling(std::vector<std::vector<float>> &training_set, const uint32_t n_classes)
+void RandomUnderSampling(const DataMatrix &training_set, const ClassStatistics &class_statistics, const uint32_t n_threads, 
+                            std::mt19937 &gen, std::vector<uint32_t> &selected_idxes)
 {
-    const uint32_t label_idx = training_set[0].size() - 1;
-    std::vector<uint32_t> data_idxes_by_class[n_classes + 1];
-    for(uint32_t data_idx = 0; data_idx < training_set.size(); data_idx++){
-        uint32_t label = training_set[data_idx][label_idx];
-        data_idxes_by_class[label].push_back(data_idx);
-    }
+    const uint32_t n_classes = class_statistics.class_labels.size();
+    // Shuffled in place, so every class works on its own copy of its rows
+    std::vector<std::vector<uint32_t>> data_idxes_by_class(n_classes + 1);
+    uint32_t sampling_size  = class_statistics.class_counts[SmallestClass(class_statistics)];
 
-    std::vector<uint32_t> class_counts(n_classes + 1, 0);
+    // Every class draws from its own generator, seeded in class order, so the result does not depend on n_threads
+    std::vector<uint32_t> class_seeds(n_classes + 1, 0);
     for(uint32_t class_idx = 1; class_idx <= n_classes; class_idx++){
-        class_counts[class_idx] = data_idxes_by_class[class_idx].size();
+        class_seeds[class_idx] = gen();
+    }
+    auto sample_class = [&](uint32_t task_idx){
+        const uint32_t class_idx = task_idx + 1; // Class labels start from 1
+        std::mt19937 class_gen(class_seeds[class_idx]);
+        data_idxes_by_class[class_idx] = class_statistics.data_idxes_by_class[class_idx];
+        PartialShuffle(data_idxes_by_class[class_idx], sampling_size, class_gen);
+    };
+    if(n_threads == 1){
+        for(uint32_t task_idx = 0; task_idx < n_classes; task_idx++){
+            sample_class(task_idx);
+        }
+    }
+    else{
+        GetThreadPool(n_threads).ParallelFor(n_classes, sample_class);
     }
 
-    uint32_t sampling_size  = CalculateSamplingSize(class_counts);
-
-    std::vector<bool> is_reserved(training_set.size(), false);
-    for(uint32_t  class_idx = 1; class_idx <= n_classes; class_idx++){
-        uint32_t seed = std::chrono::system_clock::now().time_since_epoch().count();
-        shuffle(data_idxes_by_class[class_idx].begin(), data_idxes_by_class[class_idx].end(), 
-                                                                std::default_random_engine(seed));
-
+    std::vector<bool> is_reserved(training_set.n_samples, false);
+    for(uint32_t class_idx = 1; class_idx <= n_classes; class_idx++){
         for(uint32_t shuffle_data_idx = 0; shuffle_data_idx < sampling_size; shuffle_data_idx++){
             uint32_t data_idx = data_idxes_by_class[class_idx][shuffle_data_idx];    
             is_reserved[data_idx] = true;
         }
-
     }
-
-    for(int data_idx = training_set.size() - 1; data_idx >= 0; data_idx--){
-        if(!is_reserved[data_idx]){
-            training_set.erase(training_set.begin() + data_idx);
-        }
-    }
-}
\ No newline at end of file
+    selected_idxes = SelectedIdxes(is_reserved);
+}
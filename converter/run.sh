@@ -0,0 +1,39 @@
+#!/bin/bash
+declare -a file_array=(
+    "balance"
+    "cleveland"
+    "contraceptive"
+    "dermatology"
+    "glass"
+    "hayes-roth"
+    "movement_libras"
+    "new-thyroid"
+    "optdigits"
+    "pageblocks"
+    "penbased"
+    "satimage"
+    "segment"
+    "shuttle"
+    "tae"
+    "texture"
+    "thyroid"
+    "vehicle"
+    "vowel"
+    "wine"
+    "winequality-red"
+    "winequality-white"
+    "yeast"
+)
+
+mkdir -p build
+cd build
+cmake -DCMAKE_BUILD_TYPE=Release ..
+make
+
+# Every fold file of a dataset gets a <fold>.dat.bin next to it, which ReadTrainingAndTestingSet reads instead
+declare -a directory_array=()
+for file in "${file_array[@]}"
+do
+    directory_array+=("../../datasets/${file}-5-fold")
+done
+./main "${directory_array[@]}"
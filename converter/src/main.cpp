@@ -0,0 +1,37 @@
+#include <algorithm> // std::sort
+#include <dirent.h>  // opendir, readdir, closedir
+#include "../../inc/file_operations.h" // WriteBinaryFold, BinaryFoldPath
+
+// Convert every .dat fold file of the dataset directories given as arguments into its binary fold file
+int main(int argc, char *argv[])
+{
+    if(argc < 2){
+        printf("usage: %s <dataset directory>...\n", argv[0]);
+        exit(1);
+    }
+
+    for(int arg_idx = 1; arg_idx < argc; arg_idx++){
+        const std::string directory_path = argv[arg_idx];
+        DIR *directory = opendir(directory_path.c_str());
+        if(directory == NULL){
+            printf("./%s:%d: error: open directory %s error\n", __FILE__, __LINE__, directory_path.c_str());
+            exit(1);
+        }
+        std::vector<std::string> file_names;
+        for(dirent *entry = readdir(directory); entry != NULL; entry = readdir(directory)){
+            const std::string file_name = entry->d_name;
+            if(file_name.size() > 4 && file_name.compare(file_name.size() - 4, 4, ".dat") == 0){
+                file_names.push_back(file_name);
+            }
+        }
+        closedir(directory);
+        std::sort(file_names.begin(), file_names.end());
+
+        for(const std::string &file_name : file_names){
+            const std::string file_path = directory_path + "/" + file_name;
+            WriteBinaryFold(file_path);
+            printf("%s -> %s\n", file_path.c_str(), BinaryFoldPath(file_path).c_str());
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,104 @@
+#ifndef DATA_MATRIX_H
+#define DATA_MATRIX_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>   // size_t
+#include <cstdio>    // printf
+#include <cstdlib>   // posix_memalign, free, exit
+#include <cstring>   // memcpy, memset
+#include <algorithm> // std::max
+#include <limits>    // std::numeric_limits<T>::max();
+
+// Every row of a DataMatrix starts on a multiple of this many bytes, the width of an AVX2 register
+#define DATA_MATRIX_ALIGNMENT 32
+
+// Allocator of DATA_MATRIX_ALIGNMENT-aligned storage for std::vector
+template <class T>
+struct AlignedAllocator{
+    typedef T value_type;
+
+    AlignedAllocator() {}
+    template <class U>
+    AlignedAllocator(const AlignedAllocator<U> &) {}
+
+    T* allocate(const size_t n_elements)
+    {
+        void *memory = NULL;
+        if(posix_memalign(&memory, DATA_MATRIX_ALIGNMENT, std::max(n_elements, (size_t)1) * sizeof(T)) != 0){
+            printf("./%s:%d: error: cannot allocate %zu bytes\n", __FILE__, __LINE__, n_elements * sizeof(T));
+            exit(1);
+        }
+        return (T*)memory;
+    }
+    void deallocate(T *memory, const size_t) {free(memory);}
+};
+
+template <class T, class U>
+bool operator==(const AlignedAllocator<T> &, const AlignedAllocator<U> &) {return true;}
+template <class T, class U>
+bool operator!=(const AlignedAllocator<T> &, const AlignedAllocator<U> &) {return false;}
+
+// One feature of every row, values[data_idx * stride]
+typedef struct ColumnView{
+    const float *values;
+    uint32_t stride;
+    uint32_t n_samples;
+
+    float operator[](const uint32_t data_idx) const {return values[(size_t)data_idx * stride];}
+}ColumnView;
+
+// Samples as row-major float features with the class labels in a column of their own
+// Rows are padded with zeros to stride floats, so that every row is DATA_MATRIX_ALIGNMENT-aligned
+typedef struct DataMatrix{
+    uint32_t n_samples;
+    uint32_t n_features;
+    uint32_t stride;                                    // Floats from the start of a row to the start of the next
+    std::vector<float, AlignedAllocator<float>> features; // n_samples x stride
+    std::vector<uint32_t> labels;                       // n_samples, class labels start from 1
+
+    const float* Row(const uint32_t data_idx) const {return features.data() + (size_t)data_idx * stride;}
+    float* Row(const uint32_t data_idx) {return features.data() + (size_t)data_idx * stride;}
+    ColumnView Column(const uint32_t feature_idx) const {return {features.data() + feature_idx, stride, n_samples};}
+}DataMatrix;
+
+// Row stride of a matrix with n_features features
+uint32_t DataMatrixStride(const uint32_t n_features);
+// n_samples rows of zeros labelled 0
+void InitDataMatrix(DataMatrix &matrix, const uint32_t n_samples, const uint32_t n_features);
+void AppendRow(DataMatrix &matrix, const float *features, const uint32_t label);
+// The rows matrix[row_idxes[...]] in their order
+void SelectRows(const DataMatrix &matrix, const std::vector<uint32_t> &row_idxes, DataMatrix &selected);
+
+// Min-max scaling of every feature to [0, 1], fitted on the rows it is shown
+// Keep it to scale new samples exactly the way the rows it was fitted on were scaled.
+typedef struct FeatureScaler{
+    std::vector<float> min_values;
+    std::vector<float> max_values; // Never below 0
+}FeatureScaler;
+
+// A scaler of n_features features that has not been shown any row
+void InitFeatureScaler(FeatureScaler &scaler, const uint32_t n_features);
+// Widen the range of every feature to cover row
+void FitFeatureScaler(FeatureScaler &scaler, const float *row);
+// Widen the range of every feature to cover [min_values[feature_idx], max_values[feature_idx]]
+void FitFeatureScalerRange(FeatureScaler &scaler, const float *min_values, const float *max_values);
+// Replace every feature value by (value - min) / (max - min), or by 0 if the feature is constant
+// Values of new samples outside the fitted range end up outside [0, 1]
+void ScaleDataMatrix(const FeatureScaler &scaler, DataMatrix &matrix);
+
+// The classes of a set of labelled rows, computed in one pass so that resamplers read them instead of recounting
+typedef struct ClassStatistics{
+    std::vector<uint32_t> class_counts;                     // Rows of every class, indexed by label (class_counts[0] stays 0)
+    std::vector<uint32_t> class_labels;                     // Labels that have rows, in increasing order
+    std::vector<std::vector<uint32_t>> data_idxes_by_class; // Increasing row indexes of every class, indexed by label
+}ClassStatistics;
+
+// Rows of every label, indexed by label, the histogram of ClassStatistics without the rows
+std::vector<uint32_t> CountClassRows(const std::vector<uint32_t> &labels);
+// Statistics of the rows labels[data_idx]
+void InitClassStatistics(ClassStatistics &statistics, const std::vector<uint32_t> &labels);
+// The class with the fewest rows, the smallest label among ties
+uint32_t SmallestClass(const ClassStatistics &statistics);
+
+#endif // DATA_MATRIX_H
@@ -2,11 +2,20 @@
 #define DECISION_TREE_H
 
 #include <cmath>
+#include <string>
 #include <vector>
+#include <limits>  // std::numeric_limits<float>::infinity()
 #include <cstring> // memset
 #include <iostream>
 #include <algorithm>
 #include <numeric> // std::accumulate
+#include <mutex>
+#include <memory>  // std::unique_ptr
+#include "./thread_pool.h"
+#include "./data_matrix.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h> // AVX2 gathers for PredictBatchByFlatTree
+#endif
 
 typedef struct SplitPoint{
     uint32_t feature;
@@ -21,6 +30,54 @@ typedef struct TreeNode{
     struct TreeNode *left_child;
 }TreeNode;
 
-TreeNode* CreateDecisionTree(const std::vector<std::vector<float>> &training_set, const uint32_t n_classes, const uint32_t min_samples_split, const float max_purity);
-uint32_t PredictByDecisionTree(TreeNode *root, const std::vector<float> &testing_sample);
+// Hands out tree nodes from fixed-size blocks, every node is released at once when the pool is destroyed
+class TreeNodePool{
+public:
+    TreeNodePool() : n_used_(NODE_POOL_BLOCK_SIZE) {}
+    TreeNodePool(const TreeNodePool &) = delete;
+    TreeNodePool &operator=(const TreeNodePool &) = delete;
+
+    // n_nodes (at most NODE_POOL_BLOCK_SIZE) contiguous leaf nodes, safe to call from several threads
+    TreeNode* Allocate(const uint32_t n_nodes);
+
+private:
+    static const uint32_t NODE_POOL_BLOCK_SIZE = 256;
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<TreeNode[]>> blocks_;
+    uint32_t n_used_; // Nodes handed out from the last block
+};
+
+// A trained tree, it owns its nodes and frees them when it goes out of scope
+typedef struct DecisionTree{
+    TreeNode *root;
+    std::unique_ptr<TreeNodePool> node_pool;
+}DecisionTree;
+
+// Compact inference layout of a trained tree, nodes are stored in breadth-first order
+// The right child of an internal node always directly follows its left child
+typedef struct FlatTreeNode{
+    uint32_t feature;    // Split feature, or the label of a leaf
+    float value;         // Split value
+    uint32_t left_child; // Index of the left child, 0 marks a leaf (the root is never a child)
+}FlatTreeNode;
+
+typedef struct FlatTree{
+    std::vector<FlatTreeNode> nodes;
+    uint32_t depth; // Number of edges on the longest root-to-leaf path
+}FlatTree;
+
+// split_algorithm is either "exact" (every distinct value is a candidate threshold) or "histogram" (features are quantized into at most 256 bins)
+// n_threads threads grow the tree and score the features of large nodes (0 means one per hardware thread)
+DecisionTree CreateDecisionTree(const DataMatrix &training_set, const uint32_t n_classes, const uint32_t min_samples_split, const float max_purity, 
+                                const std::string &split_algorithm, const uint32_t n_threads);
+// Train on the rows training_set.Row(sample_idxes[...]) only, an undersampler's selection needs no copy of the rows
+DecisionTree CreateDecisionTree(const DataMatrix &training_set, const std::vector<uint32_t> &sample_idxes, const uint32_t n_classes, 
+                                const uint32_t min_samples_split, const float max_purity, const std::string &split_algorithm, const uint32_t n_threads);
+// testing_sample holds the features of one sample, such as DataMatrix::Row
+uint32_t PredictByDecisionTree(TreeNode *root, const float *testing_sample);
+FlatTree CompileDecisionTree(TreeNode *root);
+uint32_t PredictByFlatTree(const FlatTree &tree, const float *testing_sample);
+// Predict a column-major block of samples, feature f of sample i is at samples[f * feature_stride + i]
+// Uses AVX2 when the CPU supports it and falls back to a scalar walk otherwise
+void PredictBatchByFlatTree(const FlatTree &tree, const float *samples, const uint32_t n_samples, const uint32_t feature_stride, uint32_t *labels);
 #endif
\ No newline at end of file
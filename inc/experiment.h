@@ -0,0 +1,74 @@
+#ifndef EXPERIMENT_H
+#define EXPERIMENT_H
+
+#include <ctime>     // timespec, clock_gettime
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <random>    // std::mt19937, std::random_device
+#include <numeric>   // std::accumulate, std::iota
+#include <algorithm> // std::max_element, std::min_element, std::stable_sort
+#include <functional>
+#include <atomic>
+#include <iostream>
+#include <sys/stat.h> // stat
+#include "./validation.h"
+#include "./file_operations.h"
+#include "./thread_pool.h"
+
+typedef struct ExperimentParameters{
+    std::string datasets_path; // Folder holding the <dataset>-5-fold folders
+    uint32_t test_time;        // Repetitions of the cross validation
+    uint32_t k_fold;
+    uint32_t n_jobs;           // (dataset, repetition, fold) jobs run at the same time, 0 means one per hardware thread
+    uint32_t seed;             // 0 means a different seed every run
+    bool use_disk_cache;
+}ExperimentParameters;
+
+// One entry per repetition, each the average over the folds
+typedef struct MultiTestMetrics{
+    std::vector<float> precision;
+    std::vector<float> recall;
+    std::vector<float> f1_score;
+    std::vector<float> g_mean;
+    std::vector<float> elapsed_time_ms; // Wall time
+    std::vector<float> cpu_time_ms;     // CPU time, unaffected by jobs that wait for a core
+}MultiTestMetrics;
+
+// Resample the training set of one fold with gen, train on it and return the accuracies on the testing set
+typedef std::function<Accuracies(const Dataset &dataset, std::mt19937 &gen)> FoldExperiment;
+
+inline float GetKFoldTestAverage(const std::vector<float> &k_fold_test_metric)
+{
+    return std::accumulate(k_fold_test_metric.begin(), k_fold_test_metric.end(), 0.f) / k_fold_test_metric.size();
+}
+
+inline float GetMultiTestAverage(const std::vector<float> &multi_test_metric)
+{
+    float total_score = std::accumulate(multi_test_metric.begin(), multi_test_metric.end(), 0.f);
+    total_score -=  *std::max_element(multi_test_metric.begin(), multi_test_metric.end());
+    total_score -=  *std::min_element(multi_test_metric.begin(), multi_test_metric.end());
+    return total_score / (multi_test_metric.size() - 2);
+}
+
+// Threads a job may use inside fold_experiment: n_threads when jobs run one at a time, otherwise 1
+// Concurrent jobs would share GetThreadPool, and a job waiting on it runs whatever task it finds, including the ones of other jobs
+inline uint32_t ThreadsPerJob(const ExperimentParameters &parameters, const uint32_t n_threads)
+{
+    return (parameters.n_jobs == 1)? n_threads : 1;
+}
+
+// Run fold_experiment on every fold of every repetition of every dataset and return the metrics of each dataset
+// The jobs run on a pool of parameters.n_jobs threads, largest datasets first. Every job draws from its own generator,
+// seeded from parameters.seed by its (dataset, repetition, fold), so the scores do not depend on n_jobs.
+// fold_experiment must use ThreadsPerJob(parameters, ...) threads. Only the time spent in it is measured.
+// When jobs run one at a time the CPU time is the one of the whole process, pool threads included.
+// Otherwise every job runs on its own thread alone and the CPU time is exactly its own work, while the wall time
+// also counts the time the job waits for a core when the jobs outnumber them.
+std::vector<MultiTestMetrics> RunExperiments(const std::vector<std::string> &dataset_names, const ExperimentParameters &parameters,
+                                                const FoldExperiment &fold_experiment);
+// Print precision, recall, F1 score, G-mean, wall time and CPU time of every dataset, one per line,
+// under a "========== <dataset> ===========" line when there are several datasets
+void PrintExperimentResults(const std::vector<std::string> &dataset_names, const std::vector<MultiTestMetrics> &metrics);
+
+#endif // EXPERIMENT_H
@@ -2,18 +2,129 @@
 #define FILE_OPERATIONS_H
 
 #include <vector>
-#include <limits>  // std::numeric_limits<T>::max();
 #include <fstream> // std::ifstream
 #include <sstream> // std::stringstream
+#include <string>
+#include <cstdint>
+#include <cctype>     // isspace
+#include <cstdlib>    // strtof
+#include <cstring>    // memcpy
+#include <fcntl.h>    // open
+#include <unistd.h>   // close, pread, pwrite, ftruncate, sysconf
+#include <sys/mman.h> // mmap, munmap
+#include <sys/stat.h> // fstat
+#include <map>
+#include <mutex>      // std::mutex, std::once_flag
+#include <functional> // std::ref, std::cref
+#include <memory>     // std::unique_ptr
+#include <algorithm>  // std::count
+#include <utility>    // std::move
+#include "./data_matrix.h"
 
 typedef struct Dataset{
     uint32_t n_classes;
-    std::vector<std::vector<float>> training_set;
-    std::vector<std::vector<float>> testing_set;
+    DataMatrix training_set;
+    DataMatrix testing_set;
+    FeatureScaler scaler;             // Fitted on both sets before they were scaled, scales new samples the same way
+    ClassStatistics class_statistics; // Of the training set, computed once when the fold is read
 }Dataset;
 
+// Map a comma-separated fold file into memory and parse it straight from the mapping, the last value of a row is its label
+// Every row is also fitted to scaler while it is parsed, unless scaler is NULL. An empty scaler takes the features of the file.
+void ReadDataMatrix(DataMatrix &matrix, const std::string &file_path, FeatureScaler *scaler);
+
+#define BINARY_FOLD_MAGIC "FOLDBIN1"
+
+// A fold file converted to binary, written by WriteBinaryFold. The header is followed by
+// the minimum then the maximum of every feature (n_features floats each), then one block of column_stride floats
+// per feature starting at columns_offset, every block DATA_MATRIX_ALIGNMENT-aligned, then the n_rows labels at labels_offset
+typedef struct BinaryFoldHeader{
+    char magic[8];
+    int64_t source_mtime_ns;  // Modification time and size of the text file it was converted from
+    uint64_t source_size;
+    uint32_t n_rows;
+    uint32_t n_features;
+    uint32_t n_classes;
+    uint32_t column_stride;   // Floats from the start of a column block to the start of the next
+    uint64_t columns_offset;  // Bytes from the start of the file
+    uint64_t labels_offset;
+}BinaryFoldHeader;
+
+// A binary fold file mapped read-only, its columns and labels are read in place
+typedef struct BinaryFold{
+    const BinaryFoldHeader *header;
+    const float *min_values;
+    const float *max_values;
+    const float *columns;
+    const uint32_t *labels;
+    size_t file_size;
+
+    ColumnView Column(const uint32_t feature_idx) const {return {columns + (size_t)feature_idx * header->column_stride, 1, header->n_rows};}
+}BinaryFold;
+
+// A binary fold file opened to be read a block of rows at a time, so that it never has to fit in memory
+typedef struct BinaryFoldFile{
+    int file;
+    BinaryFoldHeader header;
+    std::vector<float> min_values;
+    std::vector<float> max_values;
+}BinaryFoldFile;
+
+// A binary fold file written a block of rows at a time, its number of rows is fixed when it is opened
+typedef struct BinaryFoldWriter{
+    int file;
+    std::string binary_path;
+    std::string temporary_path;   // Renamed to binary_path once complete
+    BinaryFoldHeader header;
+    std::vector<float> min_values;
+    std::vector<float> max_values;
+    std::vector<uint32_t> class_counts; // Rows written of every label
+    uint32_t n_written_rows;
+}BinaryFoldWriter;
+
+// The binary conversion of the fold file at file_path, which lives next to it
+std::string BinaryFoldPath(const std::string &file_path);
+// Convert the fold file at file_path into BinaryFoldPath(file_path), a block of rows at a time
+void WriteBinaryFold(const std::string &file_path);
+// source_path is the text file the rows come from, or "" when there is none
+void OpenBinaryFoldWriter(BinaryFoldWriter &writer, const std::string &binary_path, const std::string &source_path, 
+                            const uint32_t n_rows, const uint32_t n_features);
+// Append the rows block.Row(row_idxes[...]) with their labels, every row of block when row_idxes is NULL
+void WriteBinaryFoldRows(BinaryFoldWriter &writer, const DataMatrix &block, const std::vector<uint32_t> *row_idxes);
+// Complete the file once all of its rows are written
+void CloseBinaryFoldWriter(BinaryFoldWriter &writer);
+// Return false if binary_path is missing or is not a complete binary fold
+bool MapBinaryFold(BinaryFold &binary_fold, const std::string &binary_path);
+void UnmapBinaryFold(BinaryFold &binary_fold);
+// Copy a mapped binary fold into matrix, fitting scaler to its feature ranges unless scaler is NULL
+void ReadBinaryFold(DataMatrix &matrix, const BinaryFold &binary_fold, FeatureScaler *scaler);
+// Return false if binary_path is missing or is not a complete binary fold
+bool OpenBinaryFold(BinaryFoldFile &binary_file, const std::string &binary_path);
+void CloseBinaryFold(BinaryFoldFile &binary_file);
+// Rows [begin, end) of the file with their labels, unscaled
+void ReadBinaryFoldRows(const BinaryFoldFile &binary_file, const uint32_t begin, const uint32_t end, DataMatrix &block);
+// The labels of every row
+void ReadBinaryFoldLabels(const BinaryFoldFile &binary_file, std::vector<uint32_t> &labels);
+// Whether a binary fold with this header is up to date with the fold file at file_path, or stands in for it if it was deleted
+bool IsConversionOf(const BinaryFoldHeader &header, const std::string &file_path);
+
 // The labels in the training and testing sets must start from 1 and be placed after the attributes
-// Return the normalized training and testing sets
+// Return the training and testing sets, normalized together by a scaler fitted while they are parsed
+// A fold file whose binary conversion is up to date, or whose text file is gone, is read from its conversion instead
 Dataset ReadTrainingAndTestingSet(std::string training_path, std::string testing_path);
 
+// ReadTrainingAndTestingSet that parses and normalizes every fold only once per process
+// The returned fold stays valid until it is released and must not be modified, resample it through a selection.
+// Safe to call from several threads, a fold is parsed once while other folds are parsed at the same time.
+// With use_disk_cache, both fold files are also converted by WriteBinaryFold unless their conversions are up to date,
+// so later processes read them the way ReadTrainingAndTestingSet reads any binary fold.
+const Dataset& ReadCachedTrainingAndTestingSet(const std::string &training_path, const std::string &testing_path, const bool use_disk_cache);
+// Free a fold of ReadCachedTrainingAndTestingSet once no caller uses it anymore, a later call reads it again
+void ReleaseCachedTrainingAndTestingSet(const std::string &training_path, const std::string &testing_path);
+
+// The undersamplers leave the training set untouched and return the increasing indexes of the rows they keep,
+// which Validation trains on directly. SelectedIdxes turns a per-row keep mask into such a selection,
+// SelectRows copies the selected rows out when they are needed on their own.
+std::vector<uint32_t> SelectedIdxes(const std::vector<bool> &is_selected);
+
 #endif // FILE_OPERATIONS_H
\ No newline at end of file
@@ -0,0 +1,123 @@
+#ifndef NEAREST_NEIGHBORS_H
+#define NEAREST_NEIGHBORS_H
+
+#include <cmath>     // sqrt
+#include <vector>
+#include <cstdint>
+#include <cstring>   // memcpy
+#include <numeric>   // std::iota
+#include <utility>   // std::pair
+#include <algorithm> // std::min, std::nth_element
+#include <limits>    // std::numeric_limits<float>::infinity()
+#include <queue>     // std::priority_queue
+#include <random>    // std::mt19937, std::normal_distribution
+#include <string>
+#include <cstdio>    // printf
+#include <cstdlib>   // exit
+#include <functional>
+#include "./thread_pool.h"
+#include "./data_matrix.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h> // AVX2 distance kernel
+#endif
+
+// Neighbours of query q are idxes[offsets[q] ... offsets[q + 1]) and distances[offsets[q] ... offsets[q + 1])
+// sorted by increasing distance, equal distances by increasing point index
+typedef struct NeighborLists{
+    std::vector<uint32_t> offsets;  // n_queries + 1
+    std::vector<uint32_t> idxes;    // Point indexes
+    std::vector<float> distances;   // Euclidean distances
+}NeighborLists;
+
+// Points read in place from rows of stride floats, such as the rows of a DataMatrix, without a packed copy
+// Point p is the first n_features floats of the row idxes[p], or of the row p when idxes is NULL
+typedef struct PointSet{
+    const float *rows;
+    uint32_t stride;
+    const uint32_t *idxes;
+    uint32_t n_points;
+    uint32_t n_features;
+
+    const float* Point(const uint32_t point_idx) const {return rows + (size_t)((idxes == NULL)? point_idx : idxes[point_idx]) * stride;}
+}PointSet;
+
+// The rows matrix.Row(row_idxes[...]), every row when row_idxes is NULL. row_idxes must outlive the point set
+PointSet MatrixPoints(const DataMatrix &matrix, const std::vector<uint32_t> *row_idxes);
+// n_points rows of n_features floats each, one right after the other
+PointSet PackedPoints(const float *points, const uint32_t n_points, const uint32_t n_features);
+
+typedef struct NeighborSearchParameters{
+    std::string algorithm;  // "exact" or "rp_forest" (approximate)
+    uint32_t n_trees;       // Trees of the random projection forest
+    uint32_t n_threads;     // 0 means one per hardware thread
+}NeighborSearchParameters;
+
+typedef struct KDTreeNode{
+    uint32_t begin;         // The node holds KDTree::point_idxes[begin ... end)
+    uint32_t end;
+    uint32_t split_feature;
+    float split_value;      // Points of the left child are <= split_value, points of the right child are >=
+    uint32_t left_child;    // 0 for a leaf (the root is never a child)
+    uint32_t right_child;
+}KDTreeNode;
+
+// Median-split KD-tree for exact neighbour queries on low-dimensional points
+typedef struct KDTree{
+    uint32_t n_features;
+    std::vector<float> points;         // Row-major, in leaf order
+    std::vector<uint32_t> point_idxes; // Index of every stored point in the input
+    std::vector<KDTreeNode> nodes;     // nodes[0] is the root
+}KDTree;
+
+// Points are stored column-major and padded to a multiple of 8, feature f of point p is at values[f * stride + p]
+typedef struct PointColumns{
+    uint32_t n_points;
+    uint32_t n_features;
+    uint32_t stride;
+    std::vector<float> values;
+}PointColumns;
+
+// Exact k nearest neighbour index of a point set: a KD-tree, or the columns of the blocked brute force
+typedef struct NeighborIndex{
+    uint32_t n_points;
+    bool use_kd_tree;
+    KDTree kd_tree;             // Empty unless use_kd_tree
+    PointColumns point_columns; // Empty if use_kd_tree
+}NeighborIndex;
+
+// Whether a KD-tree answers k nearest neighbour queries on n_points points faster than a linear scan, radius queries use k = 1
+bool IsKDTreeWorthwhile(const uint32_t n_points, const uint32_t n_features, const uint32_t k);
+void BuildKDTree(const PointSet &points, KDTree &tree);
+// The min(k, n_points) nearest points of query, ordered like NeighborLists
+void QueryKDTree(const KDTree &tree, const float *query, const uint32_t k, uint32_t *neighbor_idxes, float *neighbor_distances);
+
+// Exact k nearest points of every query, query q gets min(ks[q], points.n_points) neighbours
+// queries have the features of points, a query that is also a point is its own nearest neighbour
+// Squared distances add up (diff * diff) in feature order, exactly like a scalar loop, so they are bit-identical to it
+// A KD-tree is used instead of blocked brute force when IsKDTreeWorthwhile(points.n_points, points.n_features, max(ks))
+// Queries are split into chunks run on GetThreadPool(n_threads), n_threads == 1 runs them on the calling thread
+// With points == queries the result is the k-NN graph of the points
+// It is BuildNeighborIndex then QueryNeighborIndex, which let several batches of queries share one index
+void BuildNeighborIndex(const PointSet &points, const uint32_t max_k, NeighborIndex &index);
+// Any k is answered exactly, max_k of BuildNeighborIndex only picks the faster index
+void QueryNeighborIndex(const NeighborIndex &index, const PointSet &queries, const uint32_t *ks, const uint32_t n_threads, 
+                            NeighborLists &neighbor_lists);
+void FindKNearestNeighbors(const PointSet &points, const PointSet &queries, const uint32_t *ks, const uint32_t n_threads, 
+                            NeighborLists &neighbor_lists);
+// Reverse nearest neighbours: the list of point p holds every query that has p as a neighbour, by increasing query index,
+// with the same distances as neighbor_lists
+void ReverseNeighborLists(const NeighborLists &neighbor_lists, const uint32_t n_points, NeighborLists &reverse_neighbor_lists);
+// Approximate k nearest neighbours from a forest of n_trees random projection trees, ordered like NeighborLists
+// Only points that share a leaf with the query in some tree, visited nearest plane first, are candidates,
+// so a true neighbour may be missed. More trees trade time for recall. The forest is seeded, repeated calls agree
+void FindApproximateKNearestNeighbors(const PointSet &points, const PointSet &queries, const uint32_t *ks, const uint32_t n_trees, 
+                                        const uint32_t n_threads, NeighborLists &neighbor_lists);
+// FindKNearestNeighbors or FindApproximateKNearestNeighbors, as chosen by parameters.algorithm
+void SearchKNearestNeighbors(const PointSet &points, const PointSet &queries, const uint32_t *ks, const NeighborSearchParameters &parameters, 
+                                NeighborLists &neighbor_lists);
+// Every point whose squared distance to the query is at most radius * radius, ordered like NeighborLists
+// Queries are split into chunks like FindKNearestNeighbors
+void FindNeighborsInRadius(const PointSet &points, const PointSet &queries, const float radius, const uint32_t n_threads, 
+                            NeighborLists &neighbor_lists);
+
+#endif // NEAREST_NEIGHBORS_H
@@ -0,0 +1,78 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <mutex>
+#include <deque>
+#include <algorithm> // std::min
+#include <atomic>
+#include <memory> // std::unique_ptr
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <condition_variable>
+
+// Counts the unfinished tasks spawned into it, see ThreadPool::Spawn and ThreadPool::Wait
+class TaskGroup{
+public:
+    TaskGroup() : n_pending_(0) {}
+    TaskGroup(const TaskGroup &) = delete;
+    TaskGroup &operator=(const TaskGroup &) = delete;
+
+private:
+    friend class ThreadPool;
+    std::atomic<uint32_t> n_pending_;
+};
+
+// Fixed-size work-stealing pool
+// Every worker owns a task deque: it pushes and pops its own tasks at the back (depth first) and
+// steals from the front of the other deques (oldest, hence usually the largest, tasks first).
+// Threads outside the pool push into a shared deque. A thread waiting on a TaskGroup keeps
+// running queued tasks instead of blocking, so tasks may spawn and wait on nested tasks.
+// The thread that waits takes part in the work, so a pool of n threads spawns (n - 1) workers.
+class ThreadPool{
+public:
+    explicit ThreadPool(const uint32_t n_threads);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    uint32_t Size() const {return n_threads_;}
+    // Queue task as part of group
+    void Spawn(TaskGroup &group, std::function<void()> task);
+    // Return once every task of group is finished, running queued tasks in the meantime
+    void Wait(TaskGroup &group);
+    // Run body(idx) for every idx in [0, n_iterations) and return once all of them are finished
+    // Iterations are handed out one at a time, so the order in which they run is unspecified
+    void ParallelFor(const uint32_t n_iterations, const std::function<void(uint32_t)> &body);
+
+private:
+    typedef struct Task{
+        std::function<void()> function;
+        TaskGroup *group;
+    }Task;
+
+    typedef struct TaskQueue{
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    }TaskQueue;
+
+    void WorkerMain(const uint32_t queue_idx);
+    uint32_t GetQueueIdx() const;
+    bool TryPopTask(const uint32_t queue_idx, Task &task);
+    void RunTask(Task &task);
+
+    uint32_t n_threads_;
+    bool is_stopping_;              // Guarded by mutex_
+    std::atomic<uint32_t> n_queued_;
+    std::mutex mutex_;              // Only used to sleep and wake up threads
+    std::condition_variable has_work_;
+    std::vector<std::unique_ptr<TaskQueue>> queues_; // queues_[0] is shared by threads outside the pool
+    std::vector<std::thread> workers_;
+};
+
+// Process-wide pool, created with n_threads threads on first use (0 means one per hardware thread)
+// Later calls return the same pool regardless of n_threads
+ThreadPool &GetThreadPool(const uint32_t n_threads);
+
+#endif // THREAD_POOL_H
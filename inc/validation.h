@@ -4,7 +4,8 @@
 #include <cmath>  // pow
 #include <string>
 #include <vector> // std::vector
-#include "../inc/decision_tree_classifier.h" // CreateDecisionTree, PredictByDecisionTree
+#include <numeric> // std::iota
+#include "../inc/decision_tree_classifier.h" // CreateDecisionTree, CompileDecisionTree, PredictBatchByFlatTree
 
 typedef struct Accuracies{
     float macro_precision;
@@ -19,8 +20,19 @@ typedef struct ModelParameters{
     std::string model_type;
     uint32_t min_samples_split; // Parameter for decision tree
     float max_purity;           // Parameter for decision tree
+    std::string split_algorithm;// Parameter for decision tree, "exact" or "histogram"
+    uint32_t n_threads;         // Threads used to train the model, 0 means one per hardware thread
 }ModelParameters;
 
-Accuracies Validation(const std::vector<std::vector<float>> &training_set, const std::vector<std::vector<float>> &testing_set, const uint32_t n_classes, const ModelParameters model_parameters);
+Accuracies Validation(const DataMatrix &training_set, const DataMatrix &testing_set, const uint32_t n_classes, const ModelParameters model_parameters);
+// Train on the rows training_set.Row(training_idxes[...]) only, such as the selection of an undersampler
+Accuracies Validation(const DataMatrix &training_set, const std::vector<uint32_t> &training_idxes, 
+                        const DataMatrix &testing_set, const uint32_t n_classes, const ModelParameters model_parameters);
+
+// Count the predictions of tree on testing_set into confusion_matrix[predicted label][ground truth], which may
+// already hold the counts of other parts of the testing set
+void AddToConfusionMatrix(const FlatTree &tree, const DataMatrix &testing_set, std::vector<std::vector<uint32_t>> &confusion_matrix);
+// The macro metrics of a confusion matrix of n_training_classes classes, over the classes present in the ground truth
+Accuracies CalcAccuracies(const std::vector<std::vector<uint32_t>> &confusion_matrix, const uint32_t n_training_classes);
 
 #endif
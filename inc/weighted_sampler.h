@@ -0,0 +1,37 @@
+#ifndef WEIGHTED_SAMPLER_H
+#define WEIGHTED_SAMPLER_H
+
+#include <vector>
+#include <cstdio>  // printf
+#include <cstdint>
+#include <cstdlib> // exit
+#include <random>  // std::mt19937, std::uniform_real_distribution<>
+
+// Draws indexes with probability proportional to their weights from a Fenwick tree of partial sums,
+// so a draw, a removal and a weight update each cost O(log n) instead of a linear scan
+// Sums are kept in double, so removing thousands of float weights does not drift the total
+class WeightedSampler{
+public:
+    explicit WeightedSampler(const std::vector<float> &weights);
+
+    uint32_t Size() const {return weights_.size();}
+    double TotalWeight() const {return total_weight_;}
+    float Weight(const uint32_t idx) const {return weights_[idx];}
+    // Index idx is drawn with probability weights[idx] / TotalWeight(), some weight must be positive
+    uint32_t Draw(std::mt19937 &gen) const;
+    // Draw without replacement: the drawn index gets weight 0
+    uint32_t DrawAndRemove(std::mt19937 &gen);
+    void SetWeight(const uint32_t idx, const float weight);
+
+private:
+    // Smallest index whose prefix sum exceeds target
+    uint32_t FindPrefix(double target) const;
+
+    std::vector<float> weights_;
+    std::vector<double> tree_; // tree_[i] (1-based) sums weights (i - lowbit(i), i]
+    double total_weight_;
+    uint32_t n_positive_;      // Weights above 0, the total may keep a rounding residue after they are all removed
+    uint32_t highest_bit_;     // Largest power of two <= Size()
+};
+
+#endif // WEIGHTED_SAMPLER_H
@@ -13,14 +13,33 @@
 
 #include <cmath>
 #include <random>
-#include <queue>
+#include <cstring> // memcpy
 #include <utility> // std::pair
+#include <string>
 #include <iostream>
+#include <numeric>   // std::iota
 #include <algorithm>
 #include "../../inc/validation.h"
 #include "../../inc/file_operations.h"
+#include "../../inc/nearest_neighbors.h"
+#include "../../inc/weighted_sampler.h"
 
-void Proposed(std::vector<std::vector<float>> &training_set, const uint32_t n_classes, const uint32_t k, const ModelParameters model_parameters);
+// Leaves training_set untouched, the increasing indexes of the samples it keeps are returned in selected_idxes
+// class_statistics are the ones of training_set, such as Dataset::class_statistics
+void Proposed(const DataMatrix &training_set, const ClassStatistics &class_statistics, const uint32_t k, const ModelParameters model_parameters, 
+                const NeighborSearchParameters neighbor_search_parameters, std::mt19937 &gen, std::vector<uint32_t> &selected_idxes);
+
+// Proposed on a binary fold too large for memory, which is read a block of rows at a time
+// Memory stays within memory_budget_mb besides the fixed overhead of the process: 24 bytes are kept per row, the rest of
+// the budget goes to blocks of rows.
+// Rows are scaled by the feature ranges of the file. Every row looks for its sqrt(class count) exact nearest neighbours,
+// as in Proposed. The decision tree is trained on every row when they fit in the budget, which selects the rows
+// Proposed would, and on a uniform sample of the rows otherwise.
+void StreamingProposed(const std::string &binary_path, const ModelParameters model_parameters, const uint32_t n_threads, 
+                        const uint64_t memory_budget_mb, std::mt19937 &gen, std::vector<uint32_t> &selected_idxes);
+// Write the rows of the binary fold at binary_path whose increasing indexes are selected_idxes, unscaled, to a binary fold at output_path
+void WriteSelectedRows(const std::string &binary_path, const std::vector<uint32_t> &selected_idxes, const std::string &output_path, 
+                        const uint64_t memory_budget_mb);
 
 #endif
 
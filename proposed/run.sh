@@ -32,6 +32,14 @@ TEST_TIME=22
 MODEL_TYPE="decision_tree"
 MIN_SAMPLES_SPLIT=10
 MAX_PURITY=0.95
+SPLIT_ALGORITHM="exact"
+N_THREADS=1
+N_JOBS=0
+KNN_ALGORITHM="exact"
+RP_TREES=8
+SEED=0
+DISK_CACHE=1
+MEMORY_BUDGET_MB=1024
 
 CMAKE_OPTIONS="
     -DKNN=${KNN}
@@ -40,6 +48,14 @@ CMAKE_OPTIONS="
     -DMODEL_TYPE="${MODEL_TYPE}"
     -DMIN_SAMPLES_SPLIT=${MIN_SAMPLES_SPLIT}
     -DMAX_PURITY=${MAX_PURITY}
+    -DSPLIT_ALGORITHM="${SPLIT_ALGORITHM}"
+    -DN_THREADS=${N_THREADS}
+    -DN_JOBS=${N_JOBS}
+    -DKNN_ALGORITHM="${KNN_ALGORITHM}"
+    -DRP_TREES=${RP_TREES}
+    -DSEED=${SEED}
+    -DDISK_CACHE=${DISK_CACHE}
+    -DMEMORY_BUDGET_MB=${MEMORY_BUDGET_MB}
 "
 cd build
 cmake $CMAKE_OPTIONS ..
@@ -49,14 +65,12 @@ make
 # >"$filename"
 
 # echo "Start: $(date +"%Y-%m-%d %H:%M:%S")" >> "$filename"
-# echo -e "KNN=$KNN\nK_FOLD=$K_FOLD\nTEST_TIME=$TEST_TIME\nMODEL_TYPE=$MODEL_TYPE\nMIN_SAMPLES_SPLIT=$MIN_SAMPLES_SPLIT\nMAX_PURITY=$MAX_PURITY" >> "$filename"
+# echo -e "KNN=$KNN\nK_FOLD=$K_FOLD\nTEST_TIME=$TEST_TIME\nMODEL_TYPE=$MODEL_TYPE\nMIN_SAMPLES_SPLIT=$MIN_SAMPLES_SPLIT\nMAX_PURITY=$MAX_PURITY\nSPLIT_ALGORITHM=$SPLIT_ALGORITHM\nN_THREADS=$N_THREADS\nN_JOBS=$N_JOBS\nKNN_ALGORITHM=$KNN_ALGORITHM\nRP_TREES=$RP_TREES\nSEED=$SEED\nDISK_CACHE=$DISK_CACHE\nMEMORY_BUDGET_MB=$MEMORY_BUDGET_MB" >> "$filename"
 
-for file in "${file_array[@]}"
-do
-    # echo "========== $file ===========" >> "$filename"
-    # nohup ./main "$file" >> "$filename" 2> /dev/null &
-    echo "========== $file ==========="
-    ./main "$file"
-    wait $!
-done
-# echo "Finish: $(date +"%Y-%m-%d %H:%M:%S")" >> "$filename"
\ No newline at end of file
+# One process runs every dataset and prints "========== <dataset> ===========" before the results of each
+# nohup ./main "${file_array[@]}" >> "$filename" 2> /dev/null &
+./main "${file_array[@]}"
+# echo "Finish: $(date +"%Y-%m-%d %H:%M:%S")" >> "$filename"
+
+# A training fold larger than memory is undersampled within MEMORY_BUDGET_MB, the kept rows are written as a binary fold
+# ./stream <training fold file> <output binary fold>
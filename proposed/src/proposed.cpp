@@ -1,31 +1,15 @@
 #include "../inc/proposed.h"
 
-static std::vector<uint32_t> CalculateClassCounts(const std::vector<std::vector<float>> &training_set, 
-                                                    const uint32_t n_classes)
-{
-    // Class labels start from 1, so n_classes requires (n_classes + 1) space for direct indexing
-    std::vector<uint32_t> class_counts((n_classes + 1), 0); 
-
-    const uint32_t training_label_idx = training_set[0].size() - 1;
-    for(uint32_t training_data_idx = 0; training_data_idx < training_set.size(); training_data_idx++){   
-        uint32_t training_label = training_set[training_data_idx][training_label_idx];
-        class_counts[training_label]++;
-    }
-
-    return class_counts;
-}
+#define RNN_CHUNK_SIZE 1024 // Samples per thread pool task when totalling reverse nearest neighbours
 
-static float EuclideanDistance(const std::vector<float> &src, const std::vector<float> &dst)
+// Every sample looks for the sqrt(class count) nearest neighbours of its class
+static std::vector<uint32_t> SquareClassCounts(const std::vector<uint32_t> &class_counts)
 {
-    float square_distance = 0;
-
-    // the last column of vector stores the label
-    for(uint32_t training_attr_idx = 0; training_attr_idx < src.size() - 1; training_attr_idx++){
-        float diff = src[training_attr_idx] - dst[training_attr_idx];
-        square_distance += diff * diff;
+    std::vector<uint32_t> square_class_counts = class_counts;
+    for(uint32_t class_idx = 1; class_idx < class_counts.size(); class_idx++){
+        square_class_counts[class_idx] = sqrt(square_class_counts[class_idx]);
     }
-
-    return sqrt(square_distance);
+    return square_class_counts;
 }
 
 static float RelativeMinorityRate(const Accuracies &training_set_accuracies, const std::vector<uint32_t>class_counts, 
@@ -44,45 +28,14 @@ static float RelativeMinorityRate(const Accuracies &training_set_accuracies, con
     } 
 }
 
-static void CalculateSamplingWeights(const std::vector<std::vector<float>> &training_set, const Accuracies &training_set_accuracies, const std::vector<uint32_t> &class_counts, const uint32_t k, std::vector<float> &sampling_weights)
+// The more minority reverse nearest neighbours a sample has and the closer they are, the likelier it is to be removed
+static void SamplingWeightsFromMinorityRnn(const std::vector<uint32_t> &labels, const std::vector<uint32_t> &square_class_counts, 
+                                            const std::vector<uint32_t> &minority_rnn_counts, const std::vector<float> &distances_to_minority_rnn, 
+                                                std::vector<float> &sampling_weights)
 {
-    uint32_t training_data_label_idx = training_set[0].size() - 1;
-    std::vector<uint32_t> minority_rnn_counts(training_set.size(), 0);
-    std::vector<float> distances_to_minority_rnn(training_set.size(), 0.f);
-    std::vector<uint32_t> square_class_counts = class_counts;
-    for(uint32_t class_idx = 1; class_idx < class_counts.size(); class_idx++){
-        square_class_counts[class_idx] = sqrt(square_class_counts[class_idx]);
-    }
-
-    for(uint32_t training_data_idx = 0; training_data_idx < training_set.size(); training_data_idx++){
-        uint32_t training_data_label = training_set[training_data_idx][training_data_label_idx];
-
-        auto compare = [](const std::pair<uint32_t, float> &a, const std::pair<uint32_t, float> &b){return a.second < b.second;};
-        std::priority_queue<std::pair<uint32_t, float>, std::vector<std::pair<uint32_t, float>>, decltype(compare)> k_nearest_neighbors(compare);
-        for(uint32_t dst_data_idx = 0; dst_data_idx < training_set.size(); dst_data_idx++){
-            k_nearest_neighbors.push({dst_data_idx, EuclideanDistance(training_set[training_data_idx], training_set[dst_data_idx])});
-            if(k_nearest_neighbors.size() > square_class_counts[training_data_label]){
-                k_nearest_neighbors.pop();
-            }
-        }
-
-        // Total the number of Minority Reverse Nearest Neighbors (MRNN) and the distance to MRNN for each majority sample
-        while(!k_nearest_neighbors.empty()){
-            std::pair<uint32_t, float> nearest_neighbor = k_nearest_neighbors.top();
-            uint32_t nearest_neighbor_idx   = nearest_neighbor.first;
-            uint32_t nearest_neighbor_label = training_set[nearest_neighbor_idx][training_data_label_idx];
-            float relative_minority_rate = RelativeMinorityRate(training_set_accuracies, class_counts, training_data_label, nearest_neighbor_label);
-            if(relative_minority_rate > 0.f){
-                minority_rnn_counts[nearest_neighbor_idx]++;
-                distances_to_minority_rnn[nearest_neighbor_idx] += nearest_neighbor.second * relative_minority_rate;
-            }
-            k_nearest_neighbors.pop();
-        }
-    }
-    
-    sampling_weights.assign(training_set.size(), 0.f);
-    for(uint32_t training_data_idx = 0; training_data_idx < training_set.size(); training_data_idx++){
-        uint32_t training_data_label = training_set[training_data_idx][training_data_label_idx];
+    sampling_weights.assign(labels.size(), 0.f);
+    for(uint32_t training_data_idx = 0; training_data_idx < labels.size(); training_data_idx++){
+        uint32_t training_data_label = labels[training_data_idx];
         if(distances_to_minority_rnn[training_data_idx] == 0.f){
             sampling_weights[training_data_idx] = 0.f;
         }
@@ -92,45 +45,93 @@ static void CalculateSamplingWeights(const std::vector<std::vector<float>> &trai
     }
 }
 
-static void RouletteWheelSelection(std::vector<bool> &selection_result, std::vector<float> &fitness, const uint32_t n_rounds)
+static void CalculateSamplingWeights(const DataMatrix &training_set, const Accuracies &training_set_accuracies, const std::vector<uint32_t> &class_counts, const uint32_t k, 
+                                        const NeighborSearchParameters &neighbor_search_parameters, std::vector<float> &sampling_weights)
 {
-    std::random_device rd;
-    std::mt19937 gen(rd());
+    const uint32_t n_samples = training_set.n_samples;
+    std::vector<uint32_t> minority_rnn_counts(n_samples, 0);
+    std::vector<float> distances_to_minority_rnn(n_samples, 0.f);
+    std::vector<uint32_t> square_class_counts = SquareClassCounts(class_counts);
 
-    float total_fitness = std::accumulate(fitness.begin(), fitness.end(), 0.f);
-    for(uint32_t round = 0; round < n_rounds; round++)
-    {
-        std::uniform_real_distribution<> distrib(0.0, total_fitness);
-        float random_float = distrib(gen);
+    // Every sample looks for its sqrt(class count) nearest neighbours, itself included
+    const PointSet points = MatrixPoints(training_set, NULL);
+    std::vector<uint32_t> ks(n_samples);
+    for(uint32_t training_data_idx = 0; training_data_idx < n_samples; training_data_idx++){
+        ks[training_data_idx] = square_class_counts[training_set.labels[training_data_idx]];
+    }
+    NeighborLists neighbor_lists;
+    SearchKNearestNeighbors(points, points, ks.data(), neighbor_search_parameters, neighbor_lists);
 
-        uint32_t selected_individual_idx;
-        for(selected_individual_idx = 0; selected_individual_idx < fitness.size(); selected_individual_idx++){
-            random_float -= fitness[selected_individual_idx];
-            if(random_float <= 0){
-                break;
+    // Total the number of Minority Reverse Nearest Neighbors (MRNN) and the distance to MRNN for each majority sample
+    // Each sample only sums its own reverse neighbours, in increasing index order, so the chunks need no locks and the sums are deterministic
+    NeighborLists reverse_neighbor_lists;
+    ReverseNeighborLists(neighbor_lists, n_samples, reverse_neighbor_lists);
+    auto accumulate_minority_rnn = [&](uint32_t chunk_idx){
+        const uint32_t chunk_end = std::min((chunk_idx + 1) * RNN_CHUNK_SIZE, n_samples);
+        for(uint32_t training_data_idx = chunk_idx * RNN_CHUNK_SIZE; training_data_idx < chunk_end; training_data_idx++){
+            uint32_t training_data_label = training_set.labels[training_data_idx];
+            for(uint32_t rnn_idx = reverse_neighbor_lists.offsets[training_data_idx]; rnn_idx < reverse_neighbor_lists.offsets[training_data_idx + 1]; rnn_idx++){
+                uint32_t reverse_neighbor_label = training_set.labels[reverse_neighbor_lists.idxes[rnn_idx]];
+                float relative_minority_rate = RelativeMinorityRate(training_set_accuracies, class_counts, reverse_neighbor_label, training_data_label);
+                if(relative_minority_rate > 0.f){
+                    minority_rnn_counts[training_data_idx]++;
+                    distances_to_minority_rnn[training_data_idx] += reverse_neighbor_lists.distances[rnn_idx] * relative_minority_rate;
+                }
             }
         }
+    };
+    const uint32_t n_threads = neighbor_search_parameters.n_threads;
+    const uint32_t n_chunks = (n_samples + RNN_CHUNK_SIZE - 1) / RNN_CHUNK_SIZE;
+    if(n_threads == 1){
+        for(uint32_t chunk_idx = 0; chunk_idx < n_chunks; chunk_idx++){
+            accumulate_minority_rnn(chunk_idx);
+        }
+    }
+    else{
+        GetThreadPool(n_threads).ParallelFor(n_chunks, accumulate_minority_rnn);
+    }
+    
+    SamplingWeightsFromMinorityRnn(training_set.labels, square_class_counts, minority_rnn_counts, distances_to_minority_rnn, sampling_weights);
+}
 
-        // Draw without replacement
-        total_fitness -= fitness[selected_individual_idx];
-        fitness[selected_individual_idx] = 0.f;
-        selection_result[selected_individual_idx] = true;
+// As many samples as macro recall misses, at most every sample with a positive weight
+static uint32_t RemovalCount(const std::vector<float> &sampling_weights, const Accuracies &training_set_accuracies)
+{
+    const uint32_t n_samples = sampling_weights.size();
+    uint32_t n_removed_candidate = std::count_if(sampling_weights.begin(), sampling_weights.end(), 
+                                                    [](float sampling_weight){return sampling_weight > 0.f;}); 
+    uint32_t n_removed = (n_samples * (1 - training_set_accuracies.macro_recall) > n_removed_candidate)? 
+                            n_removed_candidate : n_samples * (1 - training_set_accuracies.macro_recall);
+    // uint32_t n_removed = n_removed_candidate;
+    PDEBUG("[Preprocessing Detail]\n");
+    PDEBUG("-Num Removed Candidate : %u\n", n_removed_candidate);
+    PDEBUG("-Sampling Size         : %u\n", n_removed);
+    return n_removed;
+}
+
+static void RouletteWheelSelection(std::vector<bool> &selection_result, const std::vector<float> &fitness, const uint32_t n_rounds, std::mt19937 &gen)
+{
+    // Draw without replacement
+    WeightedSampler sampler(fitness);
+    for(uint32_t round = 0; round < n_rounds; round++){
+        selection_result[sampler.DrawAndRemove(gen)] = true;
     }
 }
 
-void Proposed(std::vector<std::vector<float>> &training_set, const uint32_t n_classes, const uint32_t k, const ModelParameters model_parameters)
+void Proposed(const DataMatrix &training_set, const ClassStatistics &class_statistics, const uint32_t k, const ModelParameters model_parameters, 
+                const NeighborSearchParameters neighbor_search_parameters, std::mt19937 &gen, std::vector<uint32_t> &selected_idxes)
 {
-    std::vector<uint32_t> class_counts = CalculateClassCounts(training_set, n_classes);
+    const uint32_t n_classes = class_statistics.class_labels.size();
+    const std::vector<uint32_t> &class_counts = class_statistics.class_counts;
     PDEBUG("[Dataset Overview]\n");
-    PDEBUG("-Size             :%ld\n", training_set.size());
-    PDEBUG("-Dimension        :%ld\n", training_set[0].size());
+    PDEBUG("-Size             :%u\n", training_set.n_samples);
+    PDEBUG("-Dimension        :%u\n", training_set.n_features);
     PDEBUG("-Data Distribution:\n");
     for(uint32_t class_idx = 1; class_idx <= n_classes; class_idx++){
         PDEBUG("\tClass %u: %u (%f %%)\n", class_idx, class_counts[class_idx], 
-                                            (float)class_counts[class_idx] / training_set.size() * 100);
+                                            (float)class_counts[class_idx] / training_set.n_samples * 100);
     }
 
-    std::vector<std::vector<float>> copy = training_set;
     Accuracies training_set_accuracies = Validation(training_set, training_set, n_classes, model_parameters);
 
     FDEBUG(
@@ -153,8 +154,8 @@ void Proposed(std::vector<std::vector<float>> &training_set, const uint32_t n_cl
         }
     });
     
-    std::vector<float> sampling_weights(training_set.size(), 0.f);
-    CalculateSamplingWeights(training_set, training_set_accuracies, class_counts, k, sampling_weights);
+    std::vector<float> sampling_weights(training_set.n_samples, 0.f);
+    CalculateSamplingWeights(training_set, training_set_accuracies, class_counts, k, neighbor_search_parameters, sampling_weights);
 
     float macro_error_rate = 0;
     for(uint32_t class_idx = 1; class_idx <= n_classes; class_idx++){
@@ -164,36 +165,28 @@ void Proposed(std::vector<std::vector<float>> &training_set, const uint32_t n_cl
     }
     macro_error_rate /= n_classes;
 
-    uint32_t n_removed_candidate = std::count_if(sampling_weights.begin(), sampling_weights.end(), 
-                                                    [](float sampling_weight){return sampling_weight > 0.f;}); 
-    uint32_t n_removed = (training_set.size() * (1 - training_set_accuracies.macro_recall) > n_removed_candidate)? 
-                            n_removed_candidate : training_set.size() * (1 - training_set_accuracies.macro_recall);
-    // uint32_t n_removed = n_removed_candidate;
-    PDEBUG("[Preprocessing Detail]\n");
-    PDEBUG("-Num Removed Candidate : %u\n", n_removed_candidate);
-    PDEBUG("-Sampling Size         : %u\n", n_removed);
-
-    std::vector<bool> is_removed(training_set.size(), false);
-    RouletteWheelSelection(is_removed, sampling_weights, n_removed);
+    uint32_t n_removed = RemovalCount(sampling_weights, training_set_accuracies);
 
-    for(int training_data_idx = (training_set.size() - 1); training_data_idx >= 0; training_data_idx--){
-        if(is_removed[training_data_idx]){
-            training_set.erase(training_set.begin() + training_data_idx);
-        }
-    }
+    std::vector<bool> is_removed(training_set.n_samples, false);
+    RouletteWheelSelection(is_removed, sampling_weights, n_removed, gen);
+    is_removed.flip(); // Now marks the kept samples
+    selected_idxes = SelectedIdxes(is_removed);
 
-    
-    FDEBUG(class_counts = CalculateClassCounts(training_set, n_classes));
+    FDEBUG(
+    std::vector<uint32_t> kept_class_counts(n_classes + 1, 0);
+    for(uint32_t selected_idx = 0; selected_idx < selected_idxes.size(); selected_idx++){
+        kept_class_counts[training_set.labels[selected_idxes[selected_idx]]]++;
+    });
     PDEBUG("[Preprocessing Summary]\n");
-    PDEBUG("-Size             :%ld\n", training_set.size());
-    PDEBUG("-Dimension        :%ld\n", training_set[0].size());
+    PDEBUG("-Size             :%ld\n", selected_idxes.size());
+    PDEBUG("-Dimension        :%u\n", training_set.n_features);
     PDEBUG("-Data Distribution:\n");
     for(uint32_t class_idx = 1; class_idx <= n_classes; class_idx++){
-        PDEBUG("\tClass %u: %u (%f %%)\n", class_idx, class_counts[class_idx], 
-                                            (float)class_counts[class_idx] / training_set.size() * 100);
+        PDEBUG("\tClass %u: %u (%f %%)\n", class_idx, kept_class_counts[class_idx], 
+                                            (float)kept_class_counts[class_idx] / selected_idxes.size() * 100);
     }
     FDEBUG(
-    training_set_accuracies = Validation(training_set, copy, n_classes, model_parameters);
+    training_set_accuracies = Validation(training_set, selected_idxes, training_set, n_classes, model_parameters);
     for(uint32_t class_idx = 1; class_idx <= n_classes; class_idx++){
         for(uint32_t class_idx_ = 1; class_idx_ <= n_classes; class_idx_++){
             std::cout << training_set_accuracies.confusion_matrix[class_idx][class_idx_] << " ";
@@ -203,3 +196,266 @@ void Proposed(std::vector<std::vector<float>> &training_set, const uint32_t n_cl
 
 }
 
+// Bytes that StreamingProposed keeps for every training row: the label, the minority reverse neighbour count and distance,
+// the sampling weight and the sampler built on it
+#define STREAMING_BYTES_PER_ROW 24
+
+// Bytes of a decision tree per training row: the rows themselves and the presorted feature index built on them
+static uint64_t TreeBytesPerRow(const uint32_t n_features)
+{
+    return (uint64_t)DataMatrixStride(n_features) * sizeof(float) + (uint64_t)n_features * (sizeof(float) + sizeof(uint32_t)) * 2 + 32;
+}
+
+// Bytes of the block-nested k-NN per query of a block: the row read, the neighbours found in a point block
+// and the k nearest so far with the merge of both
+static uint64_t QueryBytesPerRow(const uint32_t n_features, const uint32_t max_k)
+{
+    return (uint64_t)DataMatrixStride(n_features) * sizeof(float) + 16 + (uint64_t)max_k * (sizeof(uint32_t) + sizeof(float)) * 3;
+}
+
+// Bytes of the block-nested k-NN per point of a block: the row read, and its copy in the KD-tree or the columns of the linear scan
+static uint64_t PointBytesPerRow(const uint32_t n_features)
+{
+    return (uint64_t)DataMatrixStride(n_features) * sizeof(float) + (uint64_t)n_features * sizeof(float) + 16;
+}
+
+// The rows [begin, end) of binary_file, scaled by scaler
+static void ReadScaledRows(const BinaryFoldFile &binary_file, const FeatureScaler &scaler, const uint32_t begin, const uint32_t end, DataMatrix &block)
+{
+    ReadBinaryFoldRows(binary_file, begin, end, block);
+    ScaleDataMatrix(scaler, block);
+}
+
+// The training set accuracies of a decision tree, trained on every row when they fit in tree_budget and on a uniform sample of them otherwise
+static Accuracies StreamingTrainingSetAccuracies(const BinaryFoldFile &binary_file, const FeatureScaler &scaler, const uint32_t n_classes, 
+                                                    const ModelParameters &model_parameters, const uint64_t tree_budget, const uint32_t block_size, 
+                                                        std::mt19937 &gen)
+{
+    if(model_parameters.model_type != "decision_tree"){
+        printf("./%s:%d: error: the streaming mode only supports the decision_tree model, not %s\n", __FILE__, __LINE__, model_parameters.model_type.c_str());
+        exit(1);
+    }
+
+    const uint32_t n_rows = binary_file.header.n_rows;
+    const uint64_t tree_bytes_per_row = TreeBytesPerRow(binary_file.header.n_features);
+    std::vector<std::vector<uint32_t>> confusion_matrix(n_classes + 1, std::vector<uint32_t>(n_classes + 1, 0));
+    if((uint64_t)n_rows * tree_bytes_per_row <= tree_budget){
+        // The same tree and the same predictions as Validation(training_set, training_set, ...)
+        DataMatrix training_set;
+        ReadScaledRows(binary_file, scaler, 0, n_rows, training_set);
+        std::vector<uint32_t> training_idxes(n_rows);
+        std::iota(training_idxes.begin(), training_idxes.end(), 0);
+        DecisionTree tree = CreateDecisionTree(training_set, training_idxes, n_classes, model_parameters.min_samples_split, 
+                                                model_parameters.max_purity, model_parameters.split_algorithm, model_parameters.n_threads);
+        AddToConfusionMatrix(CompileDecisionTree(tree.root), training_set, confusion_matrix);
+        return CalcAccuracies(confusion_matrix, n_classes);
+    }
+
+    // The sample is read a block at a time, an eighth of the budget at most goes to that block
+    const uint64_t block_bytes_per_row = (uint64_t)DataMatrixStride(binary_file.header.n_features) * sizeof(float) + sizeof(uint32_t);
+    const uint32_t sample_block_size = std::max((uint64_t)1, std::min((uint64_t)block_size, tree_budget / 8 / block_bytes_per_row));
+    const uint32_t n_tree_rows = (tree_budget - sample_block_size * block_bytes_per_row) / tree_bytes_per_row;
+    if(n_tree_rows < model_parameters.min_samples_split){
+        printf("./%s:%d: error: the memory budget leaves room to train on %u rows only\n", __FILE__, __LINE__, n_tree_rows);
+        exit(1);
+    }
+    FlatTree flat_tree;
+    {
+        // Selection sampling keeps every row with the probability (rows still needed) / (rows left), the sample stays in file order
+        DataMatrix sample, block;
+        InitDataMatrix(sample, 0, binary_file.header.n_features);
+        sample.features.reserve((size_t)n_tree_rows * sample.stride);
+        sample.labels.reserve(n_tree_rows);
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        for(uint32_t block_begin = 0; block_begin < n_rows && sample.n_samples < n_tree_rows; block_begin += sample_block_size){
+            const uint32_t block_end = std::min(block_begin + sample_block_size, n_rows);
+            ReadScaledRows(binary_file, scaler, block_begin, block_end, block);
+            for(uint32_t block_idx = 0; block_idx < block.n_samples; block_idx++){
+                const uint32_t n_rows_left = n_rows - (block_begin + block_idx);
+                if(uniform(gen) * n_rows_left < n_tree_rows - sample.n_samples){
+                    AppendRow(sample, block.Row(block_idx), block.labels[block_idx]);
+                }
+            }
+        }
+        std::vector<uint32_t> sample_idxes(sample.n_samples);
+        std::iota(sample_idxes.begin(), sample_idxes.end(), 0);
+        DecisionTree tree = CreateDecisionTree(sample, sample_idxes, n_classes, model_parameters.min_samples_split, 
+                                                model_parameters.max_purity, model_parameters.split_algorithm, model_parameters.n_threads);
+        flat_tree = CompileDecisionTree(tree.root);
+    }
+
+    DataMatrix block;
+    for(uint32_t block_begin = 0; block_begin < n_rows; block_begin += block_size){
+        ReadScaledRows(binary_file, scaler, block_begin, std::min(block_begin + block_size, n_rows), block);
+        AddToConfusionMatrix(flat_tree, block, confusion_matrix);
+    }
+    return CalcAccuracies(confusion_matrix, n_classes);
+}
+
+// Merge the neighbours found in a later point block into the k nearest so far of every query
+// Points of a later block have larger indexes, so on equal distances the neighbours so far come first, as in NeighborLists
+static void MergeNeighborLists(const NeighborLists &nearest, const NeighborLists &found, const uint32_t *ks, NeighborLists &merged)
+{
+    const uint32_t n_queries = nearest.offsets.size() - 1;
+    uint64_t n_merged = 0;
+    for(uint32_t query_idx = 0; query_idx < n_queries; query_idx++){
+        n_merged += std::min(ks[query_idx], nearest.offsets[query_idx + 1] - nearest.offsets[query_idx] + found.offsets[query_idx + 1] - found.offsets[query_idx]);
+    }
+    merged.offsets.assign(1, 0);
+    merged.offsets.reserve(n_queries + 1);
+    merged.idxes.clear();
+    merged.idxes.reserve(n_merged);
+    merged.distances.clear();
+    merged.distances.reserve(n_merged);
+    for(uint32_t query_idx = 0; query_idx < n_queries; query_idx++){
+        uint32_t nearest_idx = nearest.offsets[query_idx], found_idx = found.offsets[query_idx];
+        for(uint32_t n_neighbors = 0; n_neighbors < ks[query_idx]; n_neighbors++){
+            const bool has_nearest = nearest_idx < nearest.offsets[query_idx + 1], has_found = found_idx < found.offsets[query_idx + 1];
+            if(has_nearest && (!has_found || nearest.distances[nearest_idx] <= found.distances[found_idx])){
+                merged.idxes.push_back(nearest.idxes[nearest_idx]);
+                merged.distances.push_back(nearest.distances[nearest_idx++]);
+            }
+            else if(has_found){
+                merged.idxes.push_back(found.idxes[found_idx]);
+                merged.distances.push_back(found.distances[found_idx++]);
+            }
+            else{
+                break;
+            }
+        }
+        merged.offsets.push_back(merged.idxes.size());
+    }
+}
+
+void StreamingProposed(const std::string &binary_path, const ModelParameters model_parameters, const uint32_t n_threads, 
+                        const uint64_t memory_budget_mb, std::mt19937 &gen, std::vector<uint32_t> &selected_idxes)
+{
+    BinaryFoldFile binary_file;
+    if(!OpenBinaryFold(binary_file, binary_path)){
+        printf("./%s:%d: error: %s is not a binary fold\n", __FILE__, __LINE__, binary_path.c_str());
+        exit(1);
+    }
+    const uint32_t n_rows = binary_file.header.n_rows, n_features = binary_file.header.n_features, n_classes = binary_file.header.n_classes;
+    FeatureScaler scaler;
+    InitFeatureScaler(scaler, n_features);
+    FitFeatureScalerRange(scaler, binary_file.min_values.data(), binary_file.max_values.data());
+
+    std::vector<uint32_t> labels;
+    ReadBinaryFoldLabels(binary_file, labels);
+    std::vector<uint32_t> class_counts = CountClassRows(labels);
+    std::vector<uint32_t> square_class_counts = SquareClassCounts(class_counts);
+    const uint32_t max_k = *std::max_element(square_class_counts.begin(), square_class_counts.end());
+
+    // What the per-row state leaves of the budget goes to blocks of rows, half to queries and half to points
+    // A query carries its neighbour lists, so query blocks hold far fewer rows than point blocks
+    const uint64_t memory_budget = memory_budget_mb << 20;
+    const uint64_t row_state_bytes = (uint64_t)n_rows * STREAMING_BYTES_PER_ROW;
+    const uint64_t query_bytes_per_row = QueryBytesPerRow(n_features, max_k), point_bytes_per_row = PointBytesPerRow(n_features);
+    if(memory_budget < row_state_bytes + (query_bytes_per_row + point_bytes_per_row) * 2 * std::max(max_k, 1u)){
+        printf("./%s:%d: error: a memory budget of %lu MB is too small for %u rows\n", __FILE__, __LINE__, (unsigned long)memory_budget_mb, n_rows);
+        exit(1);
+    }
+    const uint64_t block_budget = memory_budget - row_state_bytes;
+    const uint32_t query_block_size = std::min((uint64_t)n_rows, block_budget / 2 / query_bytes_per_row);
+    const uint32_t point_block_size = std::min((uint64_t)n_rows, block_budget / 2 / point_bytes_per_row);
+
+    Accuracies training_set_accuracies = StreamingTrainingSetAccuracies(binary_file, scaler, n_classes, model_parameters, block_budget, point_block_size, gen);
+
+    // Block-nested k-NN: every block of queries is compared with every block of points, in increasing order of both,
+    // so the neighbours, the reverse neighbour order and thus the sums below are the ones of Proposed
+    // Points that fit in a single block are read and indexed once for every query block,
+    // otherwise every point block is read and indexed again for each query block, whose neighbours would not fit in the budget for all rows
+    std::vector<uint32_t> minority_rnn_counts(n_rows, 0);
+    std::vector<float> distances_to_minority_rnn(n_rows, 0.f);
+    DataMatrix query_block, point_block;
+    NeighborIndex point_index;
+    std::vector<uint32_t> ks;
+    NeighborLists nearest, found, merged;
+    if(point_block_size == n_rows){
+        ReadScaledRows(binary_file, scaler, 0, n_rows, point_block);
+        BuildNeighborIndex(MatrixPoints(point_block, NULL), max_k, point_index);
+        point_block = DataMatrix();
+    }
+    for(uint32_t query_begin = 0; query_begin < n_rows; query_begin += query_block_size){
+        const uint32_t query_end = std::min(query_begin + query_block_size, n_rows);
+        ReadScaledRows(binary_file, scaler, query_begin, query_end, query_block);
+        ks.resize(query_block.n_samples);
+        for(uint32_t query_idx = 0; query_idx < query_block.n_samples; query_idx++){
+            ks[query_idx] = square_class_counts[query_block.labels[query_idx]];
+        }
+
+        nearest.offsets.assign(query_block.n_samples + 1, 0);
+        nearest.idxes.clear();
+        nearest.distances.clear();
+        for(uint32_t point_begin = 0; point_begin < n_rows; point_begin += point_block_size){
+            const uint32_t point_end = std::min(point_begin + point_block_size, n_rows);
+            if(point_block_size < n_rows){
+                ReadScaledRows(binary_file, scaler, point_begin, point_end, point_block);
+                BuildNeighborIndex(MatrixPoints(point_block, NULL), max_k, point_index);
+            }
+            QueryNeighborIndex(point_index, MatrixPoints(query_block, NULL), ks.data(), n_threads, found);
+            for(uint32_t neighbor_idx = 0; neighbor_idx < found.idxes.size(); neighbor_idx++){
+                found.idxes[neighbor_idx] += point_begin;
+            }
+            MergeNeighborLists(nearest, found, ks.data(), merged);
+            std::swap(nearest, merged);
+        }
+
+        // Queries scatter into the totals of their neighbours in increasing query order, the order of ReverseNeighborLists
+        for(uint32_t query_idx = 0; query_idx < query_block.n_samples; query_idx++){
+            const uint32_t query_label = query_block.labels[query_idx];
+            for(uint32_t neighbor_idx = nearest.offsets[query_idx]; neighbor_idx < nearest.offsets[query_idx + 1]; neighbor_idx++){
+                const uint32_t training_data_idx = nearest.idxes[neighbor_idx];
+                float relative_minority_rate = RelativeMinorityRate(training_set_accuracies, class_counts, query_label, labels[training_data_idx]);
+                if(relative_minority_rate > 0.f){
+                    minority_rnn_counts[training_data_idx]++;
+                    distances_to_minority_rnn[training_data_idx] += nearest.distances[neighbor_idx] * relative_minority_rate;
+                }
+            }
+        }
+    }
+    CloseBinaryFold(binary_file);
+
+    std::vector<float> sampling_weights;
+    SamplingWeightsFromMinorityRnn(labels, square_class_counts, minority_rnn_counts, distances_to_minority_rnn, sampling_weights);
+    std::vector<uint32_t>().swap(minority_rnn_counts);
+    std::vector<float>().swap(distances_to_minority_rnn);
+
+    uint32_t n_removed = RemovalCount(sampling_weights, training_set_accuracies);
+    std::vector<bool> is_removed(n_rows, false);
+    RouletteWheelSelection(is_removed, sampling_weights, n_removed, gen);
+    is_removed.flip(); // Now marks the kept samples
+    selected_idxes = SelectedIdxes(is_removed);
+}
+
+void WriteSelectedRows(const std::string &binary_path, const std::vector<uint32_t> &selected_idxes, const std::string &output_path, 
+                        const uint64_t memory_budget_mb)
+{
+    BinaryFoldFile binary_file;
+    if(!OpenBinaryFold(binary_file, binary_path)){
+        printf("./%s:%d: error: %s is not a binary fold\n", __FILE__, __LINE__, binary_path.c_str());
+        exit(1);
+    }
+    const uint32_t n_rows = binary_file.header.n_rows, n_features = binary_file.header.n_features;
+    const uint64_t bytes_per_row = (uint64_t)DataMatrixStride(n_features) * sizeof(float) + sizeof(uint32_t) * 2;
+    const uint32_t block_size = std::max((uint64_t)1, std::min((uint64_t)n_rows, (memory_budget_mb << 20) / bytes_per_row));
+
+    BinaryFoldWriter writer;
+    OpenBinaryFoldWriter(writer, output_path, "", selected_idxes.size(), n_features);
+    DataMatrix block;
+    std::vector<uint32_t> block_idxes;
+    uint32_t selected_idx = 0;
+    for(uint32_t block_begin = 0; block_begin < n_rows; block_begin += block_size){
+        const uint32_t block_end = std::min(block_begin + block_size, n_rows);
+        block_idxes.clear();
+        for(; selected_idx < selected_idxes.size() && selected_idxes[selected_idx] < block_end; selected_idx++){
+            block_idxes.push_back(selected_idxes[selected_idx] - block_begin);
+        }
+        if(!block_idxes.empty()){
+            ReadBinaryFoldRows(binary_file, block_begin, block_end, block);
+            WriteBinaryFoldRows(writer, block, &block_idxes);
+        }
+    }
+    CloseBinaryFoldWriter(writer);
+    CloseBinaryFold(binary_file);
+}
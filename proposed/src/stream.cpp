@@ -0,0 +1,55 @@
+#include <sys/resource.h> // getrusage
+#include "../inc/proposed.h"
+
+// The binary fold to stream: file_path itself if it is one, otherwise its conversion, written first unless it is up to date
+static std::string StreamedBinaryFold(const std::string &file_path)
+{
+    BinaryFoldFile binary_file;
+    if(OpenBinaryFold(binary_file, file_path)){
+        CloseBinaryFold(binary_file);
+        return file_path;
+    }
+
+    const std::string binary_path = BinaryFoldPath(file_path);
+    bool is_converted = OpenBinaryFold(binary_file, binary_path);
+    if(is_converted){
+        is_converted = IsConversionOf(binary_file.header, file_path);
+        CloseBinaryFold(binary_file);
+    }
+    if(!is_converted){
+        WriteBinaryFold(file_path);
+    }
+    return binary_path;
+}
+
+// Undersample a training fold larger than memory with the proposed method and write the rows it keeps as a binary fold
+int main(int argc, char *argv[])
+{
+    if(argc != 3){
+        printf("usage: %s <training fold file> <output binary fold>\n", argv[0]);
+        exit(1);
+    }
+
+    ModelParameters model_parameters = {
+        .model_type = MODEL_TYPE,
+        .min_samples_split = MIN_SAMPLES_SPLIT,
+        .max_purity = MAX_PURITY,
+        .split_algorithm = SPLIT_ALGORITHM,
+        .n_threads = N_THREADS
+    };
+    std::mt19937 gen((SEED == 0)? std::random_device()() : SEED);
+
+    const std::string binary_path = StreamedBinaryFold(argv[1]);
+    std::vector<uint32_t> selected_idxes;
+    StreamingProposed(binary_path, model_parameters, N_THREADS, MEMORY_BUDGET_MB, gen, selected_idxes);
+    WriteSelectedRows(binary_path, selected_idxes, argv[2], MEMORY_BUDGET_MB);
+
+    BinaryFoldFile binary_file;
+    OpenBinaryFold(binary_file, binary_path);
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("kept %zu of %u rows\n", selected_idxes.size(), binary_file.header.n_rows);
+    printf("peak_rss_mb %.1f\n", usage.ru_maxrss / 1024.0);
+    CloseBinaryFold(binary_file);
+    return 0;
+}
@@ -0,0 +1,118 @@
+#include "../inc/data_matrix.h"
+
+uint32_t DataMatrixStride(const uint32_t n_features)
+{
+    const uint32_t floats_per_block = DATA_MATRIX_ALIGNMENT / sizeof(float);
+    return (n_features + floats_per_block - 1) / floats_per_block * floats_per_block;
+}
+
+void InitDataMatrix(DataMatrix &matrix, const uint32_t n_samples, const uint32_t n_features)
+{
+    matrix.n_samples  = n_samples;
+    matrix.n_features = n_features;
+    matrix.stride     = DataMatrixStride(n_features);
+    matrix.features.assign((size_t)n_samples * matrix.stride, 0.f);
+    matrix.labels.assign(n_samples, 0);
+}
+
+void AppendRow(DataMatrix &matrix, const float *features, const uint32_t label)
+{
+    matrix.features.resize(matrix.features.size() + matrix.stride, 0.f);
+    memcpy(matrix.Row(matrix.n_samples), features, matrix.n_features * sizeof(float));
+    matrix.labels.push_back(label);
+    matrix.n_samples++;
+}
+
+void SelectRows(const DataMatrix &matrix, const std::vector<uint32_t> &row_idxes, DataMatrix &selected)
+{
+    InitDataMatrix(selected, row_idxes.size(), matrix.n_features);
+    for(uint32_t selected_idx = 0; selected_idx < row_idxes.size(); selected_idx++){
+        memcpy(selected.Row(selected_idx), matrix.Row(row_idxes[selected_idx]), matrix.stride * sizeof(float));
+        selected.labels[selected_idx] = matrix.labels[row_idxes[selected_idx]];
+    }
+}
+
+void InitFeatureScaler(FeatureScaler &scaler, const uint32_t n_features)
+{
+    scaler.min_values.assign(n_features, std::numeric_limits<float>::max());
+    scaler.max_values.assign(n_features, 0.f);
+}
+
+void FitFeatureScaler(FeatureScaler &scaler, const float *row)
+{
+    FitFeatureScalerRange(scaler, row, row);
+}
+
+void FitFeatureScalerRange(FeatureScaler &scaler, const float *min_values, const float *max_values)
+{
+    float *scaler_min_values = scaler.min_values.data(), *scaler_max_values = scaler.max_values.data();
+    for(uint32_t feature_idx = 0; feature_idx < scaler.min_values.size(); feature_idx++){
+        scaler_min_values[feature_idx] = std::min(scaler_min_values[feature_idx], min_values[feature_idx]);
+        scaler_max_values[feature_idx] = std::max(scaler_max_values[feature_idx], max_values[feature_idx]);
+    }
+}
+
+void ScaleDataMatrix(const FeatureScaler &scaler, DataMatrix &matrix)
+{
+    const uint32_t n_features = matrix.n_features;
+    if(scaler.min_values.size() != n_features){
+        printf("./%s:%d: error: scaler of %zu features applied to %u features\n", __FILE__, __LINE__, scaler.min_values.size(), n_features);
+        exit(1);
+    }
+
+    // A constant feature is divided by 1 and multiplied by 0, so that the inner loop has no branch and vectorizes
+    std::vector<float> divisors(n_features), masks(n_features);
+    for(uint32_t feature_idx = 0; feature_idx < n_features; feature_idx++){
+        const float range = scaler.max_values[feature_idx] - scaler.min_values[feature_idx];
+        divisors[feature_idx] = (range == 0)? 1.f : range;
+        masks[feature_idx]    = (range == 0)? 0.f : 1.f;
+    }
+
+    const float *min_values = scaler.min_values.data(), *divisor_values = divisors.data(), *mask_values = masks.data();
+    for(uint32_t data_idx = 0; data_idx < matrix.n_samples; data_idx++){
+        float *row = matrix.Row(data_idx);
+        for(uint32_t feature_idx = 0; feature_idx < n_features; feature_idx++){
+            row[feature_idx] = (row[feature_idx] - min_values[feature_idx]) / divisor_values[feature_idx] * mask_values[feature_idx];
+        }
+    }
+}
+
+std::vector<uint32_t> CountClassRows(const std::vector<uint32_t> &labels)
+{
+    std::vector<uint32_t> class_counts(1, 0);
+    for(uint32_t data_idx = 0; data_idx < labels.size(); data_idx++){
+        if(labels[data_idx] >= class_counts.size()){
+            class_counts.resize(labels[data_idx] + 1, 0);
+        }
+        class_counts[labels[data_idx]]++;
+    }
+    return class_counts;
+}
+
+void InitClassStatistics(ClassStatistics &statistics, const std::vector<uint32_t> &labels)
+{
+    // Counted first, so that every list of rows is allocated once
+    statistics.class_counts = CountClassRows(labels);
+    statistics.class_labels.clear();
+    statistics.data_idxes_by_class.assign(statistics.class_counts.size(), std::vector<uint32_t>());
+    for(uint32_t class_idx = 1; class_idx < statistics.class_counts.size(); class_idx++){
+        if(statistics.class_counts[class_idx] > 0){
+            statistics.class_labels.push_back(class_idx);
+        }
+        statistics.data_idxes_by_class[class_idx].reserve(statistics.class_counts[class_idx]);
+    }
+    for(uint32_t data_idx = 0; data_idx < labels.size(); data_idx++){
+        statistics.data_idxes_by_class[labels[data_idx]].push_back(data_idx);
+    }
+}
+
+uint32_t SmallestClass(const ClassStatistics &statistics)
+{
+    uint32_t smallest_class = statistics.class_labels.empty()? 0 : statistics.class_labels[0];
+    for(uint32_t class_label : statistics.class_labels){
+        if(statistics.class_counts[smallest_class] > statistics.class_counts[class_label]){
+            smallest_class = class_label;
+        }
+    }
+    return smallest_class;
+}
@@ -1,8 +1,42 @@
 #include "../inc/decision_tree_classifier.h"
 
-#define IDX 0
-#define VALUE 1
-#define LABEL 2
+// Nodes with fewer (samples x features) than this are searched serially, below it the threading overhead dominates
+#define PARALLEL_SPLIT_SEARCH_CUTOFF 16384
+// Subtrees with fewer samples than this are grown inline instead of as a separate task
+#define PARALLEL_SUBTREE_CUTOFF 1024
+// Histogram split finding quantizes every feature into at most this many bins (uint8_t codes)
+#define MAX_BINS 256
+// Bin edges of a feature with more than MAX_BINS distinct values are computed from at most this many samples
+#define BIN_SAMPLE_SIZE 16384
+
+// Presorted feature index in structure-of-arrays form
+// Feature f owns the slice [f * n_samples, (f + 1) * n_samples) of sorted_idxes and values.
+// Every node owns the same range [begin, end) of every feature slice: splitting a node stably
+// partitions its range so that both children stay sorted and contiguous.
+typedef struct SortedFeatures{
+    uint32_t n_features;
+    uint32_t n_samples;
+    std::vector<uint32_t> sorted_idxes; // Row indices of each feature, sorted by that feature's values
+    std::vector<float> values;          // Column-major feature values, indexed by row
+    std::vector<uint32_t> labels;       // Row labels
+    std::vector<uint8_t> is_left;       // Side of each row in the split being applied
+    std::vector<uint32_t> buffer;       // Scratch space for partitioning, a node only touches its own range
+}SortedFeatures;
+
+// Quantized features for histogram split finding
+// Feature f owns the bins [bin_offsets[f], bin_offsets[f + 1]) and the slice [f * n_samples, (f + 1) * n_samples) of codes.
+// A node histogram counts the node's samples per (bin, class) and is laid out as [bin][class].
+// Class labels start from 1, so the class 0 slot of every bin holds the bin size.
+typedef struct BinnedFeatures{
+    uint32_t n_features;
+    uint32_t n_samples;
+    std::vector<uint8_t> codes;         // Column-major bin codes, indexed by row
+    std::vector<uint32_t> bin_offsets;  // First bin of each feature, n_features + 1 entries
+    std::vector<float> bin_min_values;  // Smallest training value of each bin
+    std::vector<float> bin_max_values;  // Largest training value of each bin
+    std::vector<uint32_t> labels;       // Row labels
+    std::vector<uint32_t> node_idxes;   // Row indices, every node owns a contiguous range
+}BinnedFeatures;
 
 static float CustomRound(float x){
     return std::round(x * 1e6) / 1e6;
@@ -31,182 +65,579 @@ static float CalculateGini(const uint32_t partition_size_y, std::vector<uint32_t
                                     (float)partition_size_n / (partition_size_y + partition_size_n) * gini_n;
 }
 
-static SplitPoint EvaluateSplitPoint(const std::vector<std::vector<std::vector<float>>> &sorted_features, const std::vector<bool> &is_existing_data, const uint32_t n_classes, const uint32_t feature_idx)
+static SplitPoint EvaluateSplitPoint(const SortedFeatures &sorted_features, const uint32_t begin, const uint32_t end, 
+                                        const std::vector<uint32_t> &class_counts, const uint32_t n_classes, const uint32_t feature_idx)
 {
     SplitPoint best = {feature_idx, 0.f, 1.1};
-    uint32_t best_split_left_idx = 0, best_split_right_idx = 0;
-    uint32_t split_left_idx = 0, split_right_idx = 0;
-    
-    uint32_t partition_size_y = 0;
+    const uint32_t *sorted_idxes = &sorted_features.sorted_idxes[(size_t)feature_idx * sorted_features.n_samples];
+    const float *values = &sorted_features.values[(size_t)feature_idx * sorted_features.n_samples];
+    const uint32_t *labels = sorted_features.labels.data();
+
+    // Sweep the node's samples in ascending order, moving them from partition n to partition y
+    uint32_t partition_size_y = 0, partition_size_n = end - begin;
     std::vector<uint32_t> class_counts_y(n_classes + 1, 0);
-    std::vector<uint32_t> class_counts_n(n_classes + 1, 0);
-    for(uint32_t idx = 0; idx < sorted_features[feature_idx].size(); idx++){
-        uint32_t data_idx = sorted_features[feature_idx][idx][IDX];
-        if(is_existing_data[data_idx]){
-            uint32_t label = sorted_features[feature_idx][idx][LABEL];
-            if(partition_size_y == 0){
-                partition_size_y++;
-                class_counts_y[label]++;
-                split_right_idx = idx;
-            }
-            else{
-                class_counts_n[label]++;
-            }
-        }
-    }
-    uint32_t partition_size_n = std::accumulate(class_counts_n.begin(), class_counts_n.end(), 0.f);
+    std::vector<uint32_t> class_counts_n = class_counts;
 
-    float class_ratio = 0.f;
+    uint32_t best_split_left_idx = begin, best_split_right_idx = begin;
+    uint32_t split_left_idx = begin;
+    float split_left_value = CustomRound(values[sorted_idxes[begin]]);
     float best_weighted_gini = 1.1;
-    while(split_left_idx < sorted_features[feature_idx].size() && split_right_idx < sorted_features[feature_idx].size()){
-        split_left_idx = split_right_idx;
-        for(split_right_idx = split_left_idx + 1; split_right_idx < sorted_features[feature_idx].size(); split_right_idx++){
-            uint32_t data_idx = sorted_features[feature_idx][split_right_idx][IDX];
-            uint32_t label    = sorted_features[feature_idx][split_right_idx][LABEL];
-            bool is_diff = CustomRound(sorted_features[feature_idx][split_left_idx][VALUE]) != 
-                                CustomRound(sorted_features[feature_idx][split_right_idx][VALUE]);
-
-            if(is_existing_data[data_idx]){
-                if(is_diff){
-                    float weighted_gini = CalculateGini(partition_size_y, class_counts_y, partition_size_n, class_counts_n);
-                    if(weighted_gini < best_weighted_gini){
-                        best_weighted_gini = weighted_gini;
-                        best_split_left_idx = split_left_idx;
-                        best_split_right_idx = split_right_idx;
-                    }
-                    partition_size_y++;
-                    class_counts_y[label]++;
-                    partition_size_n--;
-                    class_counts_n[label]--; 
-                    break;
-                }
-                partition_size_y++;
-                class_counts_y[label]++;
-                partition_size_n--;
-                class_counts_n[label]--;    
-            } 
+    for(uint32_t split_right_idx = begin; split_right_idx < end; split_right_idx++){
+        uint32_t data_idx = sorted_idxes[split_right_idx];
+        float split_right_value = CustomRound(values[data_idx]);
+        // Only the boundaries between distinct values are candidate split points
+        if(split_left_value != split_right_value){
+            float weighted_gini = CalculateGini(partition_size_y, class_counts_y, partition_size_n, class_counts_n);
+            if(weighted_gini < best_weighted_gini){
+                best_weighted_gini = weighted_gini;
+                best_split_left_idx = split_left_idx;
+                best_split_right_idx = split_right_idx;
+            }
+            split_left_idx = split_right_idx;
+            split_left_value = split_right_value;
         }
+
+        uint32_t label = labels[data_idx];
+        partition_size_y++;
+        class_counts_y[label]++;
+        partition_size_n--;
+        class_counts_n[label]--;
     }
     
     best.score = best_weighted_gini;
-    best.value = (sorted_features[feature_idx][best_split_left_idx][VALUE] + 
-                    sorted_features[feature_idx][best_split_right_idx][VALUE]) / 2;
+    best.value = (values[sorted_idxes[best_split_left_idx]] + values[sorted_idxes[best_split_right_idx]]) / 2;
    
     return best;
 }
 
-static void FindBestSplitPoint(TreeNode *node, const std::vector<std::vector<std::vector<float>>> &sorted_features, std::vector<bool> &is_existing_data, const uint32_t n_classess, const uint32_t min_samples_split, const float max_purity)
-{       
-    std::vector<uint32_t> class_counts((n_classess + 1), 0);
-    for(uint32_t idx = 0; idx < sorted_features[0].size(); idx++){
-        uint32_t data_idx = sorted_features[0][idx][IDX];
-        if(is_existing_data[data_idx]){
-            uint32_t label = sorted_features[0][idx][LABEL];
-            class_counts[label]++;
+// Stably partition the node's range of every feature so that the samples going to the left child come first
+// Return the size of the left partition, class_counts_y gets the class counts of the left partition
+static uint32_t PartitionNode(SortedFeatures &sorted_features, const uint32_t begin, const uint32_t end, const SplitPoint &split_point, 
+                                std::vector<uint32_t> &class_counts_y)
+{
+    const uint32_t n_samples = sorted_features.n_samples;
+    const float *split_values = &sorted_features.values[(size_t)split_point.feature * n_samples];
+    
+    uint32_t n_left = 0;
+    const uint32_t *node_idxes = &sorted_features.sorted_idxes[0];
+    for(uint32_t sorted_data_idx = begin; sorted_data_idx < end; sorted_data_idx++){
+        uint32_t data_idx = node_idxes[sorted_data_idx];
+        bool is_left = split_values[data_idx] <= split_point.value;
+        sorted_features.is_left[data_idx] = is_left;
+        class_counts_y[sorted_features.labels[data_idx]] += is_left;
+        n_left += is_left;
+    }
+
+    if(n_left == 0 || n_left == end - begin){
+        return n_left;
+    }
+
+    uint32_t *buffer = &sorted_features.buffer[begin];
+    for(uint32_t feature_idx = 0; feature_idx < sorted_features.n_features; feature_idx++){
+        uint32_t *sorted_idxes = &sorted_features.sorted_idxes[(size_t)feature_idx * n_samples];
+        uint32_t left_idx = begin, n_right = 0;
+        for(uint32_t sorted_data_idx = begin; sorted_data_idx < end; sorted_data_idx++){
+            uint32_t data_idx = sorted_idxes[sorted_data_idx];
+            if(sorted_features.is_left[data_idx]){
+                sorted_idxes[left_idx++] = data_idx;
+            }
+            else{
+                buffer[n_right++] = data_idx;
+            }
         }
+        memcpy(&sorted_idxes[left_idx], buffer, n_right * sizeof(uint32_t));
     }
-    
+
+    return n_left;
+}
+
+TreeNode* TreeNodePool::Allocate(const uint32_t n_nodes)
+{
+    TreeNode *nodes;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(n_used_ + n_nodes > NODE_POOL_BLOCK_SIZE){
+            try{
+                blocks_.emplace_back(new TreeNode[NODE_POOL_BLOCK_SIZE]);
+            }
+            catch(const std::bad_alloc &error){
+                printf("./%s:%d: error: %s\n", __FILE__, __LINE__, error.what());
+                exit(1);
+            }
+            n_used_ = 0;
+        }
+        nodes = &blocks_.back()[n_used_];
+        n_used_ += n_nodes;
+    }
+
+    for(uint32_t node_idx = 0; node_idx < n_nodes; node_idx++){
+        nodes[node_idx].left_child = NULL;
+        nodes[node_idx].right_child = NULL;
+    }
+    return nodes;
+}
+
+// The node owns the samples in [begin, end) of every sorted feature, class_counts holds their class counts
+// The children get their class counts from the partition instead of recounting their samples.
+// When thread_pool is not NULL, features are scored concurrently and large subtrees are grown as tasks.
+// Sibling subtrees own disjoint ranges and rows, so they never touch the same part of sorted_features.
+static void FindBestSplitPoint(TreeNode *node, SortedFeatures &sorted_features, const uint32_t begin, const uint32_t end, 
+                                const std::vector<uint32_t> &class_counts, const uint32_t n_classess, const uint32_t min_samples_split, 
+                                    const float max_purity, TreeNodePool &node_pool, ThreadPool *thread_pool)
+{       
     auto max_it = std::max_element(class_counts.begin(), class_counts.end());
     const uint32_t majority_label = std::distance(class_counts.begin(), max_it);
     const uint32_t majority_count = *max_it;
 
-    const uint32_t partition_size = std::count_if(is_existing_data.begin(), is_existing_data.end(), 
-                                                    [](bool is_existing){return is_existing;});
+    const uint32_t partition_size = end - begin;
+    node->label = majority_label;
     if(partition_size <= min_samples_split || (float)majority_count / partition_size >= max_purity){
-        node->label = majority_label;
         return;
     }   
     node->split_point = {0, 0.f, 1.1};
     
-    const uint32_t n_features = (sorted_features.size());
+    const uint32_t n_features = sorted_features.n_features;
+    std::vector<SplitPoint> feature_best_split_points(n_features);
+    auto evaluate_feature = [&](const uint32_t feature_idx){
+        feature_best_split_points[feature_idx] = EvaluateSplitPoint(sorted_features, begin, end, class_counts, n_classess, feature_idx);
+    };
+    if(thread_pool != NULL && (size_t)partition_size * n_features >= PARALLEL_SPLIT_SEARCH_CUTOFF){
+        thread_pool->ParallelFor(n_features, evaluate_feature);
+    }
+    else{
+        for(uint32_t feature_idx = 0; feature_idx < n_features; feature_idx++){
+            evaluate_feature(feature_idx);
+        }
+    }
+
+    // Reduce in feature order so that ties pick the same feature whatever the number of threads
     for(uint32_t feature_idx = 0; feature_idx < n_features; feature_idx++){
-        SplitPoint feature_best_split_point = EvaluateSplitPoint(sorted_features, is_existing_data, n_classess, feature_idx);
-        if(node->split_point.score >= feature_best_split_point.score){
-            memcpy(&(node->split_point), &(feature_best_split_point), sizeof(SplitPoint));
+        if(node->split_point.score >= feature_best_split_points[feature_idx].score){
+            memcpy(&(node->split_point), &(feature_best_split_points[feature_idx]), sizeof(SplitPoint));
         }
     }
-    
-    bool split_partition_y = false, split_partition_n = false;
-    std::vector<bool> is_existing_data_y(is_existing_data.size(), false);
-    std::vector<bool> is_existing_data_n(is_existing_data.size(), false);
-
-    for(uint32_t sorted_data_idx = 0; sorted_data_idx < sorted_features[node->split_point.feature].size(); sorted_data_idx++){
-        uint32_t data_idx = sorted_features[node->split_point.feature][sorted_data_idx][IDX];
-        
-        if(is_existing_data[data_idx]){
-            float data_attr = sorted_features[node->split_point.feature][sorted_data_idx][VALUE];
-            if(data_attr <= node->split_point.value){
-                is_existing_data_y[data_idx] = true;
-                split_partition_y = true;
-            }
-            else{
-                is_existing_data_n[data_idx] = true;
-                split_partition_n = true;
+
+    // No feature separates the samples (all of them share the same values), so the node stays a leaf
+    if(node->split_point.score > 1.f){
+        return;
+    }
+
+    std::vector<uint32_t> class_counts_y(n_classess + 1, 0);
+    const uint32_t n_left = PartitionNode(sorted_features, begin, end, node->split_point, class_counts_y);
+    if(n_left == 0 || n_left == partition_size){
+        return;
+    }
+    std::vector<uint32_t> class_counts_n(n_classess + 1, 0);
+    for(uint32_t class_idx = 0; class_idx <= n_classess; class_idx++){
+        class_counts_n[class_idx] = class_counts[class_idx] - class_counts_y[class_idx];
+    }
+
+    TreeNode *children = node_pool.Allocate(2);
+    node->left_child = &children[0];
+    node->right_child = &children[1];
+    if(thread_pool != NULL && n_left >= PARALLEL_SUBTREE_CUTOFF && partition_size - n_left >= PARALLEL_SUBTREE_CUTOFF){
+        TaskGroup subtrees;
+        thread_pool->Spawn(subtrees, [=, &sorted_features, &class_counts_y, &node_pool]{
+            FindBestSplitPoint(node->left_child, sorted_features, begin, begin + n_left, class_counts_y, n_classess, min_samples_split, max_purity, 
+                                node_pool, thread_pool);
+        });
+        FindBestSplitPoint(node->right_child, sorted_features, begin + n_left, end, class_counts_n, n_classess, min_samples_split, max_purity, 
+                            node_pool, thread_pool);
+        thread_pool->Wait(subtrees);
+    }
+    else{
+        FindBestSplitPoint(node->left_child, sorted_features, begin, begin + n_left, class_counts_y, n_classess, min_samples_split, max_purity, 
+                            node_pool, thread_pool);
+        FindBestSplitPoint(node->right_child, sorted_features, begin + n_left, end, class_counts_n, n_classess, min_samples_split, max_purity, 
+                            node_pool, thread_pool);
+    }
+}
+
+// Count the samples in [begin, end) of node_idxes per (bin, class) for every feature
+static void BuildHistogram(const BinnedFeatures &binned_features, const uint32_t begin, const uint32_t end, const uint32_t n_classes, 
+                            std::vector<uint32_t> &histogram, ThreadPool *thread_pool)
+{
+    histogram.assign((size_t)binned_features.bin_offsets.back() * (n_classes + 1), 0);
+    auto build_feature = [&](const uint32_t feature_idx){
+        const uint8_t *codes = &binned_features.codes[(size_t)feature_idx * binned_features.n_samples];
+        uint32_t *feature_histogram = &histogram[(size_t)binned_features.bin_offsets[feature_idx] * (n_classes + 1)];
+        for(uint32_t node_data_idx = begin; node_data_idx < end; node_data_idx++){
+            uint32_t data_idx = binned_features.node_idxes[node_data_idx];
+            uint32_t *bin_class_counts = &feature_histogram[codes[data_idx] * (n_classes + 1)];
+            bin_class_counts[0]++;
+            bin_class_counts[binned_features.labels[data_idx]]++;
+        }
+    };
+
+    if(thread_pool != NULL && (size_t)(end - begin) * binned_features.n_features >= PARALLEL_SPLIT_SEARCH_CUTOFF){
+        thread_pool->ParallelFor(binned_features.n_features, build_feature);
+    }
+    else{
+        for(uint32_t feature_idx = 0; feature_idx < binned_features.n_features; feature_idx++){
+            build_feature(feature_idx);
+        }
+    }
+}
+
+// Same sweep as EvaluateSplitPoint, over bins instead of sorted samples
+// split_bin receives the last bin of partition y
+static SplitPoint EvaluateHistogramSplitPoint(const BinnedFeatures &binned_features, const std::vector<uint32_t> &histogram, 
+                                                const std::vector<uint32_t> &class_counts, const uint32_t partition_size, 
+                                                    const uint32_t n_classes, const uint32_t feature_idx, uint32_t &split_bin)
+{
+    SplitPoint best = {feature_idx, 0.f, 1.1};
+    const uint32_t bin_begin = binned_features.bin_offsets[feature_idx];
+    const uint32_t bin_end   = binned_features.bin_offsets[feature_idx + 1];
+
+    uint32_t partition_size_y = 0, partition_size_n = partition_size;
+    std::vector<uint32_t> class_counts_y(n_classes + 1, 0);
+    std::vector<uint32_t> class_counts_n = class_counts;
+
+    float best_weighted_gini = 1.1;
+    uint32_t best_split_left_bin = bin_begin, best_split_right_bin = bin_begin;
+    uint32_t split_left_bin = bin_end;
+    for(uint32_t bin_idx = bin_begin; bin_idx < bin_end; bin_idx++){
+        const uint32_t *bin_class_counts = &histogram[(size_t)bin_idx * (n_classes + 1)];
+        uint32_t bin_size = bin_class_counts[0];
+        if(bin_size == 0){
+            continue;
+        }
+
+        if(split_left_bin != bin_end){
+            float weighted_gini = CalculateGini(partition_size_y, class_counts_y, partition_size_n, class_counts_n);
+            if(weighted_gini < best_weighted_gini){
+                best_weighted_gini = weighted_gini;
+                best_split_left_bin = split_left_bin;
+                best_split_right_bin = bin_idx;
             }
         }
+        split_left_bin = bin_idx;
+
+        for(uint32_t class_idx = 1; class_idx <= n_classes; class_idx++){
+            class_counts_y[class_idx] += bin_class_counts[class_idx];
+            class_counts_n[class_idx] -= bin_class_counts[class_idx];
+        }
+        partition_size_y += bin_size;
+        partition_size_n -= bin_size;
     }
-    
-    if(split_partition_y){
-        try{
-            node->left_child = new TreeNode;
-            node->left_child->left_child = NULL;
-            node->left_child->right_child = NULL;
+
+    best.score = best_weighted_gini;
+    best.value = (binned_features.bin_max_values[best_split_left_bin] + binned_features.bin_min_values[best_split_right_bin]) / 2;
+    split_bin  = best_split_left_bin - bin_begin;
+
+    return best;
+}
+
+static bool IsLeaf(const std::vector<uint32_t> &class_counts, const uint32_t partition_size, 
+                    const uint32_t min_samples_split, const float max_purity)
+{
+    const uint32_t majority_count = *std::max_element(class_counts.begin(), class_counts.end());
+    return partition_size <= min_samples_split || (float)majority_count / partition_size >= max_purity;
+}
+
+// Histogram counterpart of FindBestSplitPoint, the node owns the samples in [begin, end) of node_idxes
+// histogram holds the node histogram, or is empty if the node has to build it.
+// Only the smaller child builds its histogram from its samples, the larger one gets (parent - smaller child).
+static void FindBestHistogramSplitPoint(TreeNode *node, BinnedFeatures &binned_features, const uint32_t begin, const uint32_t end, 
+                                        std::vector<uint32_t> &class_counts, std::vector<uint32_t> &histogram,
+                                            const uint32_t n_classes, const uint32_t min_samples_split, const float max_purity, 
+                                                TreeNodePool &node_pool, ThreadPool *thread_pool)
+{
+    const uint32_t partition_size = end - begin;
+    node->label = std::distance(class_counts.begin(), std::max_element(class_counts.begin(), class_counts.end()));
+    if(IsLeaf(class_counts, partition_size, min_samples_split, max_purity)){
+        return;
+    }
+    if(histogram.empty()){
+        BuildHistogram(binned_features, begin, end, n_classes, histogram, thread_pool);
+    }
+    node->split_point = {0, 0.f, 1.1};
+
+    const uint32_t n_features = binned_features.n_features;
+    std::vector<SplitPoint> feature_best_split_points(n_features);
+    std::vector<uint32_t> feature_split_bins(n_features);
+    auto evaluate_feature = [&](const uint32_t feature_idx){
+        feature_best_split_points[feature_idx] = EvaluateHistogramSplitPoint(binned_features, histogram, class_counts, partition_size, 
+                                                                                n_classes, feature_idx, feature_split_bins[feature_idx]);
+    };
+    if(thread_pool != NULL && (size_t)partition_size * n_features >= PARALLEL_SPLIT_SEARCH_CUTOFF){
+        thread_pool->ParallelFor(n_features, evaluate_feature);
+    }
+    else{
+        for(uint32_t feature_idx = 0; feature_idx < n_features; feature_idx++){
+            evaluate_feature(feature_idx);
         }
-        catch(const std::bad_alloc &error){
-            printf("./%s:%d: error: %s\n", __FILE__, __LINE__, error.what());;
-            exit(1);
+    }
+
+    uint32_t split_bin = 0;
+    for(uint32_t feature_idx = 0; feature_idx < n_features; feature_idx++){
+        if(node->split_point.score >= feature_best_split_points[feature_idx].score){
+            memcpy(&(node->split_point), &(feature_best_split_points[feature_idx]), sizeof(SplitPoint));
+            split_bin = feature_split_bins[feature_idx];
         }
-        FindBestSplitPoint(node->left_child, sorted_features, is_existing_data_y, n_classess, min_samples_split, max_purity);
+    }
+    if(node->split_point.score > 1.f){
+        return;
     }
 
-    if(split_partition_n){
-        try{
-            node->right_child = new TreeNode;
-            node->right_child->left_child = NULL;
-            node->right_child->right_child = NULL;
+    // Partition by bin code, so that the children match the histogram counts exactly
+    std::vector<uint32_t> class_counts_y(n_classes + 1, 0);
+    const uint8_t *split_codes = &binned_features.codes[(size_t)node->split_point.feature * binned_features.n_samples];
+    uint32_t *node_idxes = binned_features.node_idxes.data();
+    uint32_t left_idx = begin;
+    for(uint32_t node_data_idx = begin; node_data_idx < end; node_data_idx++){
+        uint32_t data_idx = node_idxes[node_data_idx];
+        if(split_codes[data_idx] <= split_bin){
+            class_counts_y[binned_features.labels[data_idx]]++;
+            std::swap(node_idxes[left_idx++], node_idxes[node_data_idx]);
+        }
+    }
+    const uint32_t n_left = left_idx - begin;
+    if(n_left == 0 || n_left == partition_size){
+        return;
+    }
+    std::vector<uint32_t> class_counts_n(n_classes + 1, 0);
+    for(uint32_t class_idx = 1; class_idx <= n_classes; class_idx++){
+        class_counts_n[class_idx] = class_counts[class_idx] - class_counts_y[class_idx];
+    }
+
+    // Children that stay leaves need no histogram, and a smaller child that needs one builds it itself
+    std::vector<uint32_t> histogram_y, histogram_n;
+    const bool is_y_smaller = n_left <= partition_size - n_left;
+    const bool is_larger_leaf = is_y_smaller? IsLeaf(class_counts_n, partition_size - n_left, min_samples_split, max_purity) :
+                                                IsLeaf(class_counts_y, n_left, min_samples_split, max_purity);
+    if(!is_larger_leaf){
+        std::vector<uint32_t> &smaller_histogram = is_y_smaller? histogram_y : histogram_n;
+        std::vector<uint32_t> &larger_histogram  = is_y_smaller? histogram_n : histogram_y;
+        if(is_y_smaller){
+            BuildHistogram(binned_features, begin, begin + n_left, n_classes, smaller_histogram, thread_pool);
+        }
+        else{
+            BuildHistogram(binned_features, begin + n_left, end, n_classes, smaller_histogram, thread_pool);
+        }
+        for(size_t bin_class_idx = 0; bin_class_idx < histogram.size(); bin_class_idx++){
+            histogram[bin_class_idx] -= smaller_histogram[bin_class_idx];
+        }
+        larger_histogram.swap(histogram);
+    }
+    std::vector<uint32_t>().swap(histogram);
+
+    TreeNode *children = node_pool.Allocate(2);
+    node->left_child = &children[0];
+    node->right_child = &children[1];
+    if(thread_pool != NULL && n_left >= PARALLEL_SUBTREE_CUTOFF && partition_size - n_left >= PARALLEL_SUBTREE_CUTOFF){
+        TaskGroup subtrees;
+        thread_pool->Spawn(subtrees, [=, &binned_features, &class_counts_y, &histogram_y, &node_pool]{
+            FindBestHistogramSplitPoint(node->left_child, binned_features, begin, begin + n_left, class_counts_y, histogram_y, 
+                                            n_classes, min_samples_split, max_purity, node_pool, thread_pool);
+        });
+        FindBestHistogramSplitPoint(node->right_child, binned_features, begin + n_left, end, class_counts_n, histogram_n, 
+                                        n_classes, min_samples_split, max_purity, node_pool, thread_pool);
+        thread_pool->Wait(subtrees);
+    }
+    else{
+        FindBestHistogramSplitPoint(node->left_child, binned_features, begin, begin + n_left, class_counts_y, histogram_y, 
+                                        n_classes, min_samples_split, max_purity, node_pool, thread_pool);
+        FindBestHistogramSplitPoint(node->right_child, binned_features, begin + n_left, end, class_counts_n, histogram_n, 
+                                        n_classes, min_samples_split, max_purity, node_pool, thread_pool);
+    }
+}
+
+// Map the values of column to their rank among the distinct values, in at most two passes
+// Return false as soon as there are more than MAX_BINS distinct values
+static bool RankFewDistinctValues(const float *column, const uint32_t n_samples, uint8_t *codes, std::vector<float> &distinct_values)
+{
+    // Open addressing table keyed by the bit pattern of the values, far larger than MAX_BINS to keep probes short
+    const uint32_t table_size = 4 * 1024;
+    uint32_t keys[table_size];
+    int16_t first_seen_idxes[table_size];
+    memset(first_seen_idxes, 0xFF, sizeof(first_seen_idxes));
+
+    distinct_values.clear();
+    for(uint32_t data_idx = 0; data_idx < n_samples; data_idx++){
+        uint32_t key;
+        memcpy(&key, &column[data_idx], sizeof(uint32_t));
+        uint32_t slot = (key * 2654435761u) >> 20; // Fibonacci hashing into 12 bits
+        while(first_seen_idxes[slot] >= 0 && keys[slot] != key){
+            slot = (slot + 1) & (table_size - 1);
+        }
+        if(first_seen_idxes[slot] < 0){
+            if(distinct_values.size() == MAX_BINS){
+                return false;
+            }
+            keys[slot] = key;
+            first_seen_idxes[slot] = distinct_values.size();
+            distinct_values.push_back(column[data_idx]);
+        }
+        codes[data_idx] = first_seen_idxes[slot];
+    }
+
+    // Replace the order of first appearance by the rank
+    std::vector<uint32_t> sorted_idxes(distinct_values.size());
+    std::iota(sorted_idxes.begin(), sorted_idxes.end(), 0);
+    std::sort(sorted_idxes.begin(), sorted_idxes.end(), 
+                [&distinct_values](const uint32_t a, const uint32_t b){return distinct_values[a] < distinct_values[b];});
+    uint8_t ranks[MAX_BINS];
+    for(uint32_t rank = 0; rank < sorted_idxes.size(); rank++){
+        ranks[sorted_idxes[rank]] = rank;
+    }
+    for(uint32_t data_idx = 0; data_idx < n_samples; data_idx++){
+        codes[data_idx] = ranks[codes[data_idx]];
+    }
+    std::sort(distinct_values.begin(), distinct_values.end());
+
+    return true;
+}
+
+// Quantize every feature into at most MAX_BINS bins
+// A feature with at most MAX_BINS distinct values gets one bin per value. Otherwise the bin edges are
+// quantiles of an evenly strided sample of at most BIN_SAMPLE_SIZE values, and equal values share a bin.
+static void BuildBinnedFeatures(const DataMatrix &training_set, const std::vector<uint32_t> &sample_idxes, BinnedFeatures &binned_features)
+{
+    binned_features.n_features = training_set.n_features;
+    binned_features.n_samples  = sample_idxes.size();
+    const uint32_t n_features = binned_features.n_features;
+    const uint32_t n_samples  = binned_features.n_samples;
+    binned_features.codes.resize((size_t)n_features * n_samples);
+    binned_features.bin_offsets.assign(1, 0);
+    binned_features.bin_min_values.clear();
+    binned_features.bin_max_values.clear();
+    binned_features.labels.resize(n_samples);
+    binned_features.node_idxes.resize(n_samples);
+    std::iota(binned_features.node_idxes.begin(), binned_features.node_idxes.end(), 0);
+
+    std::vector<float> values((size_t)n_features * n_samples);
+    for(uint32_t data_idx = 0; data_idx < n_samples; data_idx++){
+        const float *row = training_set.Row(sample_idxes[data_idx]);
+        for(uint32_t feature_idx = 0; feature_idx < n_features; feature_idx++){
+            values[(size_t)feature_idx * n_samples + data_idx] = row[feature_idx];
         }
-        catch(const std::bad_alloc &error){
-            printf("./%s:%d: error: %s\n", __FILE__, __LINE__, error.what());
-            exit(1);
+        binned_features.labels[data_idx] = training_set.labels[sample_idxes[data_idx]];
+    }
+
+    std::vector<float> bin_upper_values, sampled_values;
+    for(uint32_t feature_idx = 0; feature_idx < n_features; feature_idx++){
+        const float *column = &values[(size_t)feature_idx * n_samples];
+        uint8_t *codes = &binned_features.codes[(size_t)feature_idx * n_samples];
+        const uint32_t first_bin = binned_features.bin_offsets.back();
+
+        if(RankFewDistinctValues(column, n_samples, codes, bin_upper_values)){
+            binned_features.bin_min_values.insert(binned_features.bin_min_values.end(), bin_upper_values.begin(), bin_upper_values.end());
+            binned_features.bin_max_values.insert(binned_features.bin_max_values.end(), bin_upper_values.begin(), bin_upper_values.end());
+            binned_features.bin_offsets.push_back(first_bin + bin_upper_values.size());
+            continue;
+        }
+
+        const uint32_t sample_stride = std::max(n_samples / BIN_SAMPLE_SIZE, 1u);
+        sampled_values.clear();
+        for(uint32_t data_idx = 0; data_idx < n_samples; data_idx += sample_stride){
+            sampled_values.push_back(column[data_idx]);
         }
-        FindBestSplitPoint(node->right_child, sorted_features, is_existing_data_n, n_classess, min_samples_split, max_purity);
+        std::sort(sampled_values.begin(), sampled_values.end());
+
+        // Every bin but the last holds at least min_bin_size sampled values, so there are at most MAX_BINS of them
+        const uint32_t min_bin_size = (sampled_values.size() + MAX_BINS - 1) / MAX_BINS;
+        uint32_t bin_size = 0;
+        bin_upper_values.clear();
+        for(uint32_t sample_idx = 0; sample_idx < sampled_values.size(); sample_idx++){
+            if(bin_size >= min_bin_size && sampled_values[sample_idx] != sampled_values[sample_idx - 1]){
+                bin_upper_values.push_back(sampled_values[sample_idx - 1]);
+                bin_size = 0;
+            }
+            bin_size++;
+        }
+        // The last bin also takes the values above the largest sampled one
+        bin_upper_values.push_back(std::numeric_limits<float>::infinity());
+
+        // The bin of a value is the first bin whose upper value is not smaller
+        const uint32_t n_bins = bin_upper_values.size();
+        binned_features.bin_min_values.resize(first_bin + n_bins, std::numeric_limits<float>::infinity());
+        binned_features.bin_max_values.resize(first_bin + n_bins, -std::numeric_limits<float>::infinity());
+        float *bin_min_values = &binned_features.bin_min_values[first_bin];
+        float *bin_max_values = &binned_features.bin_max_values[first_bin];
+        for(uint32_t data_idx = 0; data_idx < n_samples; data_idx++){
+            const float value = column[data_idx];
+            const uint32_t bin_idx = std::lower_bound(bin_upper_values.begin(), bin_upper_values.end(), value) - bin_upper_values.begin();
+            codes[data_idx] = bin_idx;
+            bin_min_values[bin_idx] = std::min(bin_min_values[bin_idx], value);
+            bin_max_values[bin_idx] = std::max(bin_max_values[bin_idx], value);
+        }
+        binned_features.bin_offsets.push_back(first_bin + n_bins);
     }
 }
 
-TreeNode* CreateDecisionTree(const std::vector<std::vector<float>> &training_set, const uint32_t n_classes, const uint32_t min_samples_split, const float max_purity)
+DecisionTree CreateDecisionTree(const DataMatrix &training_set, const uint32_t n_classes, const uint32_t min_samples_split, const float max_purity, 
+                                const std::string &split_algorithm, const uint32_t n_threads)
+{
+    std::vector<uint32_t> sample_idxes(training_set.n_samples);
+    std::iota(sample_idxes.begin(), sample_idxes.end(), 0);
+    return CreateDecisionTree(training_set, sample_idxes, n_classes, min_samples_split, max_purity, split_algorithm, n_threads);
+}
+
+DecisionTree CreateDecisionTree(const DataMatrix &training_set, const std::vector<uint32_t> &sample_idxes, const uint32_t n_classes, 
+                                const uint32_t min_samples_split, const float max_purity, const std::string &split_algorithm, const uint32_t n_threads)
 {
-    TreeNode *root;
-    try{
-        root = new TreeNode;
-        root->left_child = NULL;
-        root->right_child = NULL;
+    DecisionTree tree;
+    tree.node_pool.reset(new TreeNodePool);
+    tree.root = tree.node_pool->Allocate(1);
+    TreeNode *root = tree.root;
+    ThreadPool *thread_pool = (n_threads == 1)? NULL : &GetThreadPool(n_threads);
+
+    if(split_algorithm == "histogram"){
+        BinnedFeatures binned_features;
+        BuildBinnedFeatures(training_set, sample_idxes, binned_features);
+        std::vector<uint32_t> class_counts(n_classes + 1, 0);
+        for(uint32_t data_idx = 0; data_idx < binned_features.n_samples; data_idx++){
+            class_counts[binned_features.labels[data_idx]]++;
+        }
+        std::vector<uint32_t> histogram;
+        FindBestHistogramSplitPoint(root, binned_features, 0, binned_features.n_samples, class_counts, histogram, 
+                                        n_classes, min_samples_split, max_purity, *tree.node_pool, thread_pool);
+        return tree;
     }
-    catch(const std::bad_alloc& error){
-        printf("./%s:%d: error: %s\n", __FILE__, __LINE__, error.what());
+    else if(split_algorithm != "exact"){
+        printf("./%s:%d: error: unknown split algorithm %s\n", __FILE__, __LINE__, split_algorithm.c_str());
         exit(1);
     }
 
-    // dimension * data_size * 3(idx, value, label)
-    std::vector<std::vector<std::vector<float>>> sorted_features(training_set[0].size() - 1, std::vector<std::vector<float>>(training_set.size(), std::vector<float>(3, 0.f)));
-    
-    const uint32_t label_idx = training_set[0].size() - 1;
-    for(uint32_t feature_idx = 0; feature_idx < training_set[0].size() - 1; feature_idx++){
-        for(uint32_t data_idx = 0; data_idx < training_set.size(); data_idx++){
-            sorted_features[feature_idx][data_idx][IDX]   = data_idx;
-            sorted_features[feature_idx][data_idx][VALUE] = training_set[data_idx][feature_idx];
-            sorted_features[feature_idx][data_idx][LABEL] = training_set[data_idx][label_idx];
+    SortedFeatures sorted_features;
+    sorted_features.n_features = training_set.n_features;
+    sorted_features.n_samples  = sample_idxes.size();
+    const uint32_t n_features = sorted_features.n_features;
+    const uint32_t n_samples  = sorted_features.n_samples;
+    sorted_features.sorted_idxes.resize((size_t)n_features * n_samples);
+    sorted_features.values.resize((size_t)n_features * n_samples);
+    sorted_features.labels.resize(n_samples);
+    sorted_features.is_left.resize(n_samples);
+    sorted_features.buffer.resize(n_samples);
+
+    for(uint32_t data_idx = 0; data_idx < n_samples; data_idx++){
+        const float *row = training_set.Row(sample_idxes[data_idx]);
+        for(uint32_t feature_idx = 0; feature_idx < n_features; feature_idx++){
+            sorted_features.values[(size_t)feature_idx * n_samples + data_idx] = row[feature_idx];
         }
-        std::sort(sorted_features[feature_idx].begin(), sorted_features[feature_idx].end(), 
-                    [](const std::vector<float> &a, const std::vector<float> &b){return a[VALUE] < b[VALUE];});
+        sorted_features.labels[data_idx] = training_set.labels[sample_idxes[data_idx]];
     }
 
-    std::vector<bool> is_existing_data(training_set.size(), true);
-    FindBestSplitPoint(root, sorted_features, is_existing_data, n_classes, min_samples_split, max_purity);
+    // Argsort every column
+    for(uint32_t feature_idx = 0; feature_idx < n_features; feature_idx++){
+        uint32_t *sorted_idxes = &sorted_features.sorted_idxes[(size_t)feature_idx * n_samples];
+        const float *values = &sorted_features.values[(size_t)feature_idx * n_samples];
+        std::iota(sorted_idxes, sorted_idxes + n_samples, 0);
+        std::sort(sorted_idxes, sorted_idxes + n_samples, 
+                    [values](const uint32_t a, const uint32_t b){return values[a] < values[b];});
+    }
+
+    std::vector<uint32_t> class_counts(n_classes + 1, 0);
+    for(uint32_t data_idx = 0; data_idx < n_samples; data_idx++){
+        class_counts[sorted_features.labels[data_idx]]++;
+    }
+    FindBestSplitPoint(root, sorted_features, 0, n_samples, class_counts, n_classes, min_samples_split, max_purity, *tree.node_pool, thread_pool);
 
-    return root;
+    return tree;
 }
 
-uint32_t PredictByDecisionTree(TreeNode *root, const std::vector<float> &testing_sample)
+uint32_t PredictByDecisionTree(TreeNode *root, const float *testing_sample)
 {
     if(root->left_child == NULL && root->right_child == NULL){
         return root->label;
@@ -220,8 +651,169 @@ uint32_t PredictByDecisionTree(TreeNode *root, const std::vector<float> &testing
     }
 }
 
+FlatTree CompileDecisionTree(TreeNode *root)
+{
+    FlatTree tree;
+    tree.depth = 0;
 
+    // Breadth-first walk, node_depths[i] is the depth of nodes[i]
+    std::vector<TreeNode*> bfs_nodes(1, root);
+    std::vector<uint32_t> node_depths(1, 0);
+    for(uint32_t node_idx = 0; node_idx < bfs_nodes.size(); node_idx++){
+        TreeNode *node = bfs_nodes[node_idx];
+        tree.depth = std::max(tree.depth, node_depths[node_idx]);
 
+        FlatTreeNode flat_node;
+        if(node->left_child == NULL && node->right_child == NULL){
+            flat_node.feature    = node->label;
+            flat_node.value      = 0.f;
+            flat_node.left_child = 0;
+        }
+        else{
+            flat_node.feature    = node->split_point.feature;
+            flat_node.value      = node->split_point.value;
+            flat_node.left_child = bfs_nodes.size();
+            bfs_nodes.push_back(node->left_child);
+            bfs_nodes.push_back(node->right_child);
+            node_depths.push_back(node_depths[node_idx] + 1);
+            node_depths.push_back(node_depths[node_idx] + 1);
+        }
+        tree.nodes.push_back(flat_node);
+    }
+    return tree;
+}
 
+uint32_t PredictByFlatTree(const FlatTree &tree, const float *testing_sample)
+{
+    const FlatTreeNode *nodes = tree.nodes.data();
+    uint32_t node_idx = 0;
+    while(nodes[node_idx].left_child != 0){
+        const FlatTreeNode &node = nodes[node_idx];
+        // Same comparison as PredictByDecisionTree, so NaN features also go right
+        if(testing_sample[node.feature] <= node.value){
+            node_idx = node.left_child;
+        }
+        else{
+            node_idx = node.left_child + 1;
+        }
+    }
+    return nodes[node_idx].feature;
+}
+
+static void PredictBatchByFlatTreeScalar(const FlatTree &tree, const float *samples, const uint32_t n_samples, const uint32_t feature_stride, uint32_t *labels)
+{
+    const FlatTreeNode *nodes = tree.nodes.data();
+    for(uint32_t sample_idx = 0; sample_idx < n_samples; sample_idx++){
+        uint32_t node_idx = 0;
+        while(nodes[node_idx].left_child != 0){
+            const FlatTreeNode &node = nodes[node_idx];
+            if(samples[(size_t)node.feature * feature_stride + sample_idx] <= node.value){
+                node_idx = node.left_child;
+            }
+            else{
+                node_idx = node.left_child + 1;
+            }
+        }
+        labels[sample_idx] = nodes[node_idx].feature;
+    }
+}
 
+#if defined(__x86_64__) || defined(__i386__)
+#define BATCH_LANES 32 // Samples in flight, four AVX2 vectors of independent gathers hide the gather latency
+#define IDLE_LANE UINT32_MAX
 
+// Every lane walks its own sample down the tree, one level per step, with gathers and compares
+// A lane that reaches a leaf writes the label and is refilled with the next sample, so short paths do not wait for long ones
+__attribute__((target("avx2")))
+static void PredictBatchByFlatTreeAvx2(const FlatTree &tree, const float *samples, const uint32_t n_samples, const uint32_t feature_stride, uint32_t *labels)
+{
+    const int *nodes = (const int*)tree.nodes.data();
+    const __m256i stride   = _mm256_set1_epi32(feature_stride);
+    const __m256i zeros    = _mm256_setzero_si256();
+    const __m256i ones     = _mm256_set1_epi32(1);
+    const __m256i all_ones = _mm256_set1_epi32(-1);
+    const __m256i idle     = _mm256_set1_epi32(IDLE_LANE);
+
+    // Idle lanes park on a leaf, so their sample is never read
+    uint32_t parking_leaf = 0;
+    while(tree.nodes[parking_leaf].left_child != 0){
+        parking_leaf++;
+    }
+
+    alignas(32) uint32_t lane_nodes[BATCH_LANES], lane_samples[BATCH_LANES];
+    uint32_t next_sample = 0, n_busy_lanes = 0;
+    for(uint32_t lane_idx = 0; lane_idx < BATCH_LANES; lane_idx++){
+        if(next_sample < n_samples){
+            lane_nodes[lane_idx] = 0;
+            lane_samples[lane_idx] = next_sample++;
+            n_busy_lanes++;
+        }
+        else{
+            lane_nodes[lane_idx] = parking_leaf;
+            lane_samples[lane_idx] = IDLE_LANE;
+        }
+    }
+
+    while(n_busy_lanes > 0){
+        for(uint32_t lane_idx = 0; lane_idx < BATCH_LANES; lane_idx += 8){
+            __m256i node_idxes   = _mm256_load_si256((const __m256i*)(lane_nodes + lane_idx));
+            __m256i sample_idxes = _mm256_load_si256((const __m256i*)(lane_samples + lane_idx));
+            __m256i node_offsets = _mm256_add_epi32(_mm256_add_epi32(node_idxes, node_idxes), node_idxes); // 3 ints per node
+
+            __m256i left_children = _mm256_i32gather_epi32(nodes + 2, node_offsets, 4);
+            __m256i features      = _mm256_i32gather_epi32(nodes, node_offsets, 4); // The label at a leaf
+            __m256  values        = _mm256_i32gather_ps((const float*)nodes + 1, node_offsets, 4);
+            __m256i at_leaf       = _mm256_cmpeq_epi32(left_children, zeros);
+            __m256i active        = _mm256_xor_si256(at_leaf, all_ones);
+
+            __m256i sample_offsets = _mm256_add_epi32(_mm256_mullo_epi32(features, stride), sample_idxes);
+            __m256  sample_values  = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), samples, sample_offsets, _mm256_castsi256_ps(active), 4);
+
+            // Ordered compare, so NaN features go right like in PredictByFlatTree
+            __m256i go_left    = _mm256_castps_si256(_mm256_cmp_ps(sample_values, values, _CMP_LE_OQ));
+            __m256i next_idxes = _mm256_sub_epi32(_mm256_add_epi32(left_children, ones), _mm256_and_si256(go_left, ones));
+            _mm256_store_si256((__m256i*)(lane_nodes + lane_idx), _mm256_blendv_epi8(node_idxes, next_idxes, active));
+
+            uint32_t finished = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_andnot_si256(_mm256_cmpeq_epi32(sample_idxes, idle), at_leaf)));
+            if(finished == 0){
+                continue;
+            }
+            alignas(32) uint32_t leaf_labels[8];
+            _mm256_store_si256((__m256i*)leaf_labels, features);
+            for(; finished != 0; finished &= finished - 1){
+                uint32_t group_lane = __builtin_ctz(finished);
+                labels[lane_samples[lane_idx + group_lane]] = leaf_labels[group_lane];
+                if(next_sample < n_samples){
+                    lane_nodes[lane_idx + group_lane] = 0;
+                    lane_samples[lane_idx + group_lane] = next_sample++;
+                }
+                else{
+                    lane_nodes[lane_idx + group_lane] = parking_leaf;
+                    lane_samples[lane_idx + group_lane] = IDLE_LANE;
+                    n_busy_lanes--;
+                }
+            }
+        }
+    }
+}
+#endif
+
+void PredictBatchByFlatTree(const FlatTree &tree, const float *samples, const uint32_t n_samples, const uint32_t feature_stride, uint32_t *labels)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+
+    // The gather offsets are 32-bit
+    uint32_t max_feature = 0;
+    for(const FlatTreeNode &node : tree.nodes){
+        if(node.left_child != 0){
+            max_feature = std::max(max_feature, node.feature);
+        }
+    }
+    if(has_avx2 && ((uint64_t)max_feature + 1) * feature_stride < INT32_MAX){
+        PredictBatchByFlatTreeAvx2(tree, samples, n_samples, feature_stride, labels);
+        return;
+    }
+#endif
+    PredictBatchByFlatTreeScalar(tree, samples, n_samples, feature_stride, labels);
+}
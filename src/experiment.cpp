@@ -0,0 +1,148 @@
+#include "../inc/experiment.h"
+
+typedef struct ExperimentJob{
+    uint32_t dataset_idx;
+    uint32_t test_idx;
+    uint32_t fold;      // 1 ... k_fold
+    uint32_t seed;
+}ExperimentJob;
+
+typedef struct JobResult{
+    Accuracies accuracies;
+    float elapsed_time_ms;
+    float cpu_time_ms;
+}JobResult;
+
+static std::string FoldPath(const ExperimentParameters &parameters, const std::string &dataset_name, const uint32_t fold, const std::string &suffix)
+{
+    return parameters.datasets_path + dataset_name + "-5-fold/" + dataset_name + "-5-" + std::to_string(fold) + suffix;
+}
+
+static float ElapsedMs(const timespec &start_ns, const timespec &end_ns)
+{
+    return (float)(end_ns.tv_sec - start_ns.tv_sec) * 1000 + (float)(end_ns.tv_nsec - start_ns.tv_nsec) / 1000000;
+}
+
+// Size of the first training fold, 0 if it cannot be read (the job will report the error)
+static off_t DatasetSize(const ExperimentParameters &parameters, const std::string &dataset_name)
+{
+    struct stat file_stat;
+    if(stat(FoldPath(parameters, dataset_name, 1, "tra.dat").c_str(), &file_stat) != 0){
+        return 0;
+    }
+    return file_stat.st_size;
+}
+
+std::vector<MultiTestMetrics> RunExperiments(const std::vector<std::string> &dataset_names, const ExperimentParameters &parameters,
+                                                const FoldExperiment &fold_experiment)
+{
+    // Seeds are drawn in (dataset, repetition, fold) order, before any job runs
+    std::mt19937 gen((parameters.seed == 0)? std::random_device()() : parameters.seed);
+    std::vector<ExperimentJob> jobs;
+    jobs.reserve((size_t)dataset_names.size() * parameters.test_time * parameters.k_fold);
+    for(uint32_t dataset_idx = 0; dataset_idx < dataset_names.size(); dataset_idx++){
+        for(uint32_t test_idx = 0; test_idx < parameters.test_time; test_idx++){
+            for(uint32_t fold = 1; fold <= parameters.k_fold; fold++){
+                jobs.push_back({dataset_idx, test_idx, fold, (uint32_t)gen()});
+            }
+        }
+    }
+
+    // Largest datasets first, so that the longest jobs do not start last
+    std::vector<off_t> dataset_sizes(dataset_names.size());
+    for(uint32_t dataset_idx = 0; dataset_idx < dataset_names.size(); dataset_idx++){
+        dataset_sizes[dataset_idx] = DatasetSize(parameters, dataset_names[dataset_idx]);
+    }
+    std::stable_sort(jobs.begin(), jobs.end(), [&](const ExperimentJob &lhs, const ExperimentJob &rhs){
+        return dataset_sizes[lhs.dataset_idx] > dataset_sizes[rhs.dataset_idx];
+    });
+
+    const uint32_t n_jobs = (parameters.n_jobs == 0)? std::thread::hardware_concurrency() : parameters.n_jobs;
+    const clockid_t cpu_clock = (n_jobs == 1)? CLOCK_PROCESS_CPUTIME_ID : CLOCK_THREAD_CPUTIME_ID;
+    std::vector<JobResult> job_results(jobs.size());
+    // A fold is released by the last of its repetitions, so that only the folds of running datasets stay in memory
+    std::vector<std::atomic<uint32_t>> n_unfinished_repetitions((size_t)dataset_names.size() * parameters.k_fold);
+    for(std::atomic<uint32_t> &n_repetitions : n_unfinished_repetitions){
+        n_repetitions = parameters.test_time;
+    }
+    auto run_job = [&](uint32_t job_idx){
+        const ExperimentJob &job = jobs[job_idx];
+        const std::string &dataset_name = dataset_names[job.dataset_idx];
+        const std::string training_path = FoldPath(parameters, dataset_name, job.fold, "tra.dat");
+        const std::string testing_path = FoldPath(parameters, dataset_name, job.fold, "tst.dat");
+        const Dataset &dataset = ReadCachedTrainingAndTestingSet(training_path, testing_path, parameters.use_disk_cache);
+        std::mt19937 job_gen(job.seed);
+
+        timespec start_ns = {0}, end_ns = {0}, cpu_start_ns = {0}, cpu_end_ns = {0};
+        clock_gettime(CLOCK_MONOTONIC, &start_ns);
+        clock_gettime(cpu_clock, &cpu_start_ns);
+        job_results[job_idx].accuracies = fold_experiment(dataset, job_gen);
+        clock_gettime(cpu_clock, &cpu_end_ns);
+        clock_gettime(CLOCK_MONOTONIC, &end_ns);
+        job_results[job_idx].elapsed_time_ms = ElapsedMs(start_ns, end_ns);
+        job_results[job_idx].cpu_time_ms = ElapsedMs(cpu_start_ns, cpu_end_ns);
+
+        if(--n_unfinished_repetitions[(size_t)job.dataset_idx * parameters.k_fold + job.fold - 1] == 0){
+            ReleaseCachedTrainingAndTestingSet(training_path, testing_path);
+        }
+    };
+    if(n_jobs == 1){
+        for(uint32_t job_idx = 0; job_idx < jobs.size(); job_idx++){
+            run_job(job_idx);
+        }
+    }
+    else{
+        // A pool of its own, GetThreadPool stays free for the parallel work inside the jobs
+        ThreadPool job_pool(n_jobs);
+        job_pool.ParallelFor(jobs.size(), run_job);
+    }
+
+    // Put the folds of every repetition back together, in fold order
+    std::vector<std::vector<std::vector<JobResult>>> fold_results(dataset_names.size(),
+                                                                    std::vector<std::vector<JobResult>>(parameters.test_time,
+                                                                        std::vector<JobResult>(parameters.k_fold)));
+    for(uint32_t job_idx = 0; job_idx < jobs.size(); job_idx++){
+        fold_results[jobs[job_idx].dataset_idx][jobs[job_idx].test_idx][jobs[job_idx].fold - 1] = job_results[job_idx];
+    }
+
+    std::vector<MultiTestMetrics> metrics(dataset_names.size());
+    for(uint32_t dataset_idx = 0; dataset_idx < dataset_names.size(); dataset_idx++){
+        MultiTestMetrics &multi_test_metrics = metrics[dataset_idx];
+        for(uint32_t test_idx = 0; test_idx < parameters.test_time; test_idx++){
+            MultiTestMetrics k_fold_test_metrics = {{}, {}, {}, {}, {}, {}};
+            for(uint32_t fold_idx = 0; fold_idx < parameters.k_fold; fold_idx++){
+                const JobResult &job_result = fold_results[dataset_idx][test_idx][fold_idx];
+                k_fold_test_metrics.precision.push_back(job_result.accuracies.macro_precision);
+                k_fold_test_metrics.recall.push_back(job_result.accuracies.macro_recall);
+                k_fold_test_metrics.f1_score.push_back(job_result.accuracies.macro_f1_score);
+                k_fold_test_metrics.g_mean.push_back(job_result.accuracies.g_mean);
+                k_fold_test_metrics.elapsed_time_ms.push_back(job_result.elapsed_time_ms);
+                k_fold_test_metrics.cpu_time_ms.push_back(job_result.cpu_time_ms);
+            }
+
+            multi_test_metrics.precision.push_back(GetKFoldTestAverage(k_fold_test_metrics.precision));
+            multi_test_metrics.recall.push_back(GetKFoldTestAverage(k_fold_test_metrics.recall));
+            multi_test_metrics.f1_score.push_back(GetKFoldTestAverage(k_fold_test_metrics.f1_score));
+            multi_test_metrics.g_mean.push_back(GetKFoldTestAverage(k_fold_test_metrics.g_mean));
+            multi_test_metrics.elapsed_time_ms.push_back(GetKFoldTestAverage(k_fold_test_metrics.elapsed_time_ms));
+            multi_test_metrics.cpu_time_ms.push_back(GetKFoldTestAverage(k_fold_test_metrics.cpu_time_ms));
+        }
+    }
+    return metrics;
+}
+
+void PrintExperimentResults(const std::vector<std::string> &dataset_names, const std::vector<MultiTestMetrics> &metrics)
+{
+    for(uint32_t dataset_idx = 0; dataset_idx < dataset_names.size(); dataset_idx++){
+        if(dataset_names.size() > 1){
+            std::cout << "========== " << dataset_names[dataset_idx] << " ===========" << std::endl;
+        }
+        const MultiTestMetrics &multi_test_metrics = metrics[dataset_idx];
+        std::cout << GetMultiTestAverage(multi_test_metrics.precision) << std::endl;
+        std::cout << GetMultiTestAverage(multi_test_metrics.recall)    << std::endl;
+        std::cout << GetMultiTestAverage(multi_test_metrics.f1_score)  << std::endl;
+        std::cout << GetMultiTestAverage(multi_test_metrics.g_mean)    << std::endl;
+        std::cout << GetMultiTestAverage(multi_test_metrics.elapsed_time_ms)  << std::endl;
+        std::cout << GetMultiTestAverage(multi_test_metrics.cpu_time_ms)  << std::endl;
+    }
+}
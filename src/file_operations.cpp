@@ -1,110 +1,645 @@
 #include "../inc/file_operations.h"
 
-static bool IsLabelExist(const std::vector<uint32_t> &labels, const uint32_t label)
+// The classes of the training set, read by the resamplers instead of recounting them
+static void GetClassStatistics(Dataset &dataset)
 {
-    for(uint32_t label_idx = 0; label_idx < labels.size(); label_idx++){
-        if(labels[label_idx] == label){
-            return true;
+    InitClassStatistics(dataset.class_statistics, dataset.training_set.labels);
+    dataset.n_classes = dataset.class_statistics.class_labels.size();
+}
+
+// 10^0 ... 10^10 are exact in float
+static const float EXACT_POWERS_OF_TEN[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+
+// Parse the number in [begin, end) the way strtof does
+// Decimals with at most 7 significant digits and a small exponent, which covers the KEEL datasets, are
+// an exact integer times or over an exact power of ten, and a single float operation rounds them correctly.
+// Everything else (long mantissas, large exponents, inf, nan) goes through strtof.
+static float ParseFloat(const char *begin, const char *end)
+{
+    const char *cursor = begin;
+    bool is_negative = false;
+    if(cursor < end && (*cursor == '-' || *cursor == '+')){
+        is_negative = (*cursor == '-');
+        cursor++;
+    }
+
+    uint32_t mantissa = 0, n_digits = 0;
+    int32_t exponent = 0;
+    const char *digits_begin = cursor;
+    for(; cursor < end && (uint8_t)(*cursor - '0') < 10; cursor++){
+        if(mantissa != 0 || *cursor != '0'){
+            n_digits++;
+        }
+        mantissa = mantissa * 10 + (*cursor - '0');
+        if(n_digits > 7){
+            break;
+        }
+    }
+    if(cursor < end && *cursor == '.' && n_digits <= 7){
+        cursor++;
+        for(; cursor < end && (uint8_t)(*cursor - '0') < 10; cursor++){
+            if(mantissa != 0 || *cursor != '0'){
+                n_digits++;
+            }
+            mantissa = mantissa * 10 + (*cursor - '0');
+            exponent--;
+            if(n_digits > 7){
+                break;
+            }
+        }
+    }
+    if(cursor < end && (*cursor == 'e' || *cursor == 'E') && n_digits <= 7 && cursor > digits_begin){
+        const char *exponent_cursor = cursor + 1;
+        bool is_exponent_negative = false;
+        if(exponent_cursor < end && (*exponent_cursor == '-' || *exponent_cursor == '+')){
+            is_exponent_negative = (*exponent_cursor == '-');
+            exponent_cursor++;
+        }
+        int32_t explicit_exponent = 0;
+        const char *exponent_digits_begin = exponent_cursor;
+        for(; exponent_cursor < end && (uint8_t)(*exponent_cursor - '0') < 10 && explicit_exponent < 1000; exponent_cursor++){
+            explicit_exponent = explicit_exponent * 10 + (*exponent_cursor - '0');
+        }
+        if(exponent_cursor > exponent_digits_begin){
+            exponent += is_exponent_negative? -explicit_exponent : explicit_exponent;
+            cursor = exponent_cursor;
         }
     }
 
-    return false;
+    if(cursor == end && cursor > digits_begin && n_digits <= 7 && exponent >= -10 && exponent <= 10){
+        float value = (float)mantissa; // Exact, mantissa < 10^7 < 2^24
+        value = (exponent < 0)? value / EXACT_POWERS_OF_TEN[-exponent] : value * EXACT_POWERS_OF_TEN[exponent];
+        return is_negative? -value : value;
+    }
+
+    char token[128];
+    const size_t token_size = std::min((size_t)(end - begin), sizeof(token) - 1);
+    memcpy(token, begin, token_size);
+    token[token_size] = '\0';
+    return strtof(token, NULL);
+}
+
+// Make an empty scaler one of n_features features, a scaler that already has features must have n_features of them
+static void PrepareScaler(FeatureScaler &scaler, const uint32_t n_features, const std::string &file_path)
+{
+    if(scaler.min_values.empty()){
+        InitFeatureScaler(scaler, n_features);
+    }
+    else if(scaler.min_values.size() != n_features){
+        printf("./%s:%d: error: %s has %u features, expected %zu\n", __FILE__, __LINE__, 
+                    file_path.c_str(), n_features, scaler.min_values.size());
+        exit(1);
+    }
 }
 
-static void GetNumClasses(Dataset &dataset)
+// Map the whole file read-only for a sequential read, NULL if it is empty
+static const char* MapTextFile(const std::string &file_path, size_t &file_size)
 {
-    std::vector<uint32_t> labels;
-    uint32_t label_idx = dataset.training_set[0].size() - 1;
-    for(uint32_t data_idx = 0; data_idx < (dataset.training_set).size(); data_idx++){
-        uint32_t data_label = dataset.training_set[data_idx][label_idx];
-        if(!IsLabelExist(labels, data_label)){
-            labels.push_back(data_label);
+    int file = open(file_path.c_str(), O_RDONLY);
+    struct stat file_stat;
+    if(file < 0 || fstat(file, &file_stat) != 0){
+        printf("./%s:%d: error: open file error\n", __FILE__, __LINE__);
+        exit(1);
+    }
+
+    file_size = file_stat.st_size;
+    if(file_size == 0){
+        close(file);
+        return NULL;
+    }
+    const char *buffer = (const char*)mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if(buffer == MAP_FAILED){
+        printf("./%s:%d: error: mmap file error\n", __FILE__, __LINE__);
+        exit(1);
+    }
+    madvise((void*)buffer, file_size, MADV_SEQUENTIAL);
+    return buffer;
+}
+
+// Parse the row that starts at cursor into data_row, which is left empty for a blank line, and return the start of the next row
+static const char* ParseRow(const char *cursor, const char *buffer_end, std::vector<float> &data_row)
+{
+    const char *row_end = (const char*)memchr(cursor, '\n', buffer_end - cursor);
+    if(row_end == NULL){
+        row_end = buffer_end;
+    }
+
+    // Split the row on commas, the attributes come first and the label last
+    data_row.clear();
+    while(cursor < row_end){
+        const char *token_end = (const char*)memchr(cursor, ',', row_end - cursor);
+        if(token_end == NULL){
+            token_end = row_end;
+        }
+        const char *token_begin = cursor;
+        const char *token_last = token_end;
+        while(token_begin < token_last && isspace((uint8_t)*token_begin)){
+            token_begin++;
+        }
+        while(token_last > token_begin && isspace((uint8_t)token_last[-1])){
+            token_last--;
         }
+        if(token_begin < token_last){
+            data_row.push_back(ParseFloat(token_begin, token_last));
+        }
+        cursor = token_end + 1;
     }
+    return row_end + 1;
+}
 
-    dataset.n_classes = labels.size();
+void ReadDataMatrix(DataMatrix &matrix, const std::string &file_path, FeatureScaler *scaler)
+{
+    InitDataMatrix(matrix, 0, 0);
+    size_t file_size = 0;
+    const char *buffer = MapTextFile(file_path, file_size);
+    if(buffer == NULL){
+        return;
+    }
+
+    const char *cursor = buffer, *buffer_end = buffer + file_size;
+    std::vector<float> data_row;
+    while(cursor < buffer_end){
+        cursor = ParseRow(cursor, buffer_end, data_row);
+        if(data_row.empty()){
+            continue; // Blank line
+        }
+
+        if(matrix.n_samples == 0){
+            InitDataMatrix(matrix, 0, data_row.size() - 1);
+        }
+        else if(data_row.size() != matrix.n_features + 1){
+            printf("./%s:%d: error: row %u of %s has %zu values, expected %u\n", __FILE__, __LINE__, 
+                        matrix.n_samples + 1, file_path.c_str(), data_row.size(), matrix.n_features + 1);
+            exit(1);
+        }
+        AppendRow(matrix, data_row.data(), data_row.back());
+        if(scaler != NULL){
+            PrepareScaler(*scaler, matrix.n_features, file_path);
+            FitFeatureScaler(*scaler, data_row.data());
+        }
+    }
+    munmap((void*)buffer, file_size);
+}
+
+static bool GetFileVersion(const std::string &file_path, int64_t &mtime_ns, uint64_t &size)
+{
+    struct stat file_stat;
+    if(stat(file_path.c_str(), &file_stat) != 0){
+        return false;
+    }
+    mtime_ns = (int64_t)file_stat.st_mtim.tv_sec * 1000000000 + file_stat.st_mtim.tv_nsec;
+    size = file_stat.st_size;
+    return true;
+}
+
+std::string BinaryFoldPath(const std::string &file_path)
+{
+    return file_path + ".bin";
+}
+
+// Place the ranges, the column blocks and the labels of a binary fold of n_rows rows and n_features features
+static void LayOutBinaryFold(BinaryFoldHeader &header, const uint32_t n_rows, const uint32_t n_features)
+{
+    header.n_rows         = n_rows;
+    header.n_features     = n_features;
+    header.column_stride  = DataMatrixStride(n_rows);
+    header.columns_offset = (sizeof(header) + 2 * sizeof(float) * n_features + DATA_MATRIX_ALIGNMENT - 1) / 
+                                DATA_MATRIX_ALIGNMENT * DATA_MATRIX_ALIGNMENT;
+    header.labels_offset  = header.columns_offset + sizeof(float) * header.column_stride * n_features;
+}
+
+static bool IsValidBinaryFoldHeader(const BinaryFoldHeader &header, const uint64_t file_size)
+{
+    return memcmp(header.magic, BINARY_FOLD_MAGIC, sizeof(header.magic)) == 0 && 
+            header.column_stride >= header.n_rows &&
+            header.columns_offset % DATA_MATRIX_ALIGNMENT == 0 &&
+            header.columns_offset >= sizeof(BinaryFoldHeader) + 2 * sizeof(float) * (uint64_t)header.n_features &&
+            header.labels_offset >= header.columns_offset + sizeof(float) * (uint64_t)header.column_stride * header.n_features &&
+            header.labels_offset + sizeof(uint32_t) * (uint64_t)header.n_rows <= file_size;
 }
 
-static void ReadDataset(std::vector<std::vector<float>> &dataset, const std::string file_path)
+static void WriteAt(const BinaryFoldWriter &writer, const void *data, const size_t size, const uint64_t offset)
 {
-    std::ifstream file;
-    file.open(file_path, std::ios::in);
-    if (!file.is_open()){
+    for(size_t n_written = 0; n_written < size; ){
+        const ssize_t n_bytes = pwrite(writer.file, (const char*)data + n_written, size - n_written, offset + n_written);
+        if(n_bytes <= 0){
+            remove(writer.temporary_path.c_str());
+            printf("./%s:%d: error: cannot write %s\n", __FILE__, __LINE__, writer.temporary_path.c_str());
+            exit(1);
+        }
+        n_written += n_bytes;
+    }
+}
+
+void OpenBinaryFoldWriter(BinaryFoldWriter &writer, const std::string &binary_path, const std::string &source_path, 
+                            const uint32_t n_rows, const uint32_t n_features)
+{
+    memset(&writer.header, 0, sizeof(writer.header));
+    memcpy(writer.header.magic, BINARY_FOLD_MAGIC, sizeof(writer.header.magic));
+    if(!source_path.empty() && !GetFileVersion(source_path, writer.header.source_mtime_ns, writer.header.source_size)){
         printf("./%s:%d: error: open file error\n", __FILE__, __LINE__);
         exit(1);
     }
+    LayOutBinaryFold(writer.header, n_rows, n_features);
+
+    // Written under a temporary name and renamed, so a reader never maps a partial file
+    writer.binary_path = binary_path;
+    writer.temporary_path = binary_path + "." + std::to_string(getpid());
+    writer.file = open(writer.temporary_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(writer.file < 0){
+        printf("./%s:%d: error: cannot write %s\n", __FILE__, __LINE__, writer.temporary_path.c_str());
+        exit(1);
+    }
+    // The padding between the blocks reads as zeros
+    if(ftruncate(writer.file, writer.header.labels_offset + sizeof(uint32_t) * (uint64_t)n_rows) != 0){
+        close(writer.file);
+        remove(writer.temporary_path.c_str());
+        printf("./%s:%d: error: cannot write %s\n", __FILE__, __LINE__, writer.temporary_path.c_str());
+        exit(1);
+    }
+
+    writer.min_values.assign(n_features, std::numeric_limits<float>::max());
+    writer.max_values.assign(n_features, -std::numeric_limits<float>::max());
+    writer.class_counts.assign(1, 0);
+    writer.n_written_rows = 0;
+}
+
+void WriteBinaryFoldRows(BinaryFoldWriter &writer, const DataMatrix &block, const std::vector<uint32_t> *row_idxes)
+{
+    const uint32_t n_rows = (row_idxes == NULL)? block.n_samples : row_idxes->size();
+    const BinaryFoldHeader &header = writer.header;
+    if(block.n_features != header.n_features || writer.n_written_rows + n_rows > header.n_rows){
+        remove(writer.temporary_path.c_str());
+        printf("./%s:%d: error: %u rows of %u features do not fit %s\n", __FILE__, __LINE__, n_rows, block.n_features, writer.binary_path.c_str());
+        exit(1);
+    }
+
+    std::vector<float> column(n_rows);
+    for(uint32_t feature_idx = 0; feature_idx < header.n_features; feature_idx++){
+        for(uint32_t row_idx = 0; row_idx < n_rows; row_idx++){
+            const float value = block.Row((row_idxes == NULL)? row_idx : (*row_idxes)[row_idx])[feature_idx];
+            column[row_idx] = value;
+            writer.min_values[feature_idx] = std::min(writer.min_values[feature_idx], value);
+            writer.max_values[feature_idx] = std::max(writer.max_values[feature_idx], value);
+        }
+        WriteAt(writer, column.data(), sizeof(float) * n_rows, 
+                    header.columns_offset + sizeof(float) * ((uint64_t)feature_idx * header.column_stride + writer.n_written_rows));
+    }
 
-    std::string file_row;
-    while (getline(file, file_row)){
-        std::stringstream ss(file_row);
-        std::string attribute;
-        std::vector<float> data_row;
-        
-        while(getline(ss, attribute, ',')){
-            data_row.push_back(std::stof(attribute.c_str()));
+    std::vector<uint32_t> labels(n_rows);
+    for(uint32_t row_idx = 0; row_idx < n_rows; row_idx++){
+        labels[row_idx] = block.labels[(row_idxes == NULL)? row_idx : (*row_idxes)[row_idx]];
+        if(labels[row_idx] >= writer.class_counts.size()){
+            writer.class_counts.resize(labels[row_idx] + 1, 0);
         }
-        dataset.push_back(data_row);
+        writer.class_counts[labels[row_idx]]++;
     }
-    file.close();
+    WriteAt(writer, labels.data(), sizeof(uint32_t) * n_rows, header.labels_offset + sizeof(uint32_t) * (uint64_t)writer.n_written_rows);
+    writer.n_written_rows += n_rows;
 }
 
-static void Normalize(Dataset &dataset)
+void CloseBinaryFoldWriter(BinaryFoldWriter &writer)
 {
-    // Normalized data without labels
-    uint32_t n_dimensions = dataset.training_set[0].size() - 1;
-    for(uint32_t dim_idx = 0; dim_idx < n_dimensions; dim_idx++){
-        // Find the maximum and minimum values across both the training and testing sets
-        float max = 0, min = std::numeric_limits<float>::max();
-        for(uint32_t training_data_idx = 0; training_data_idx < dataset.training_set.size(); training_data_idx++){
-            if(dataset.training_set[training_data_idx][dim_idx] > max){
-                max = dataset.training_set[training_data_idx][dim_idx];
-            }
+    if(writer.n_written_rows != writer.header.n_rows){
+        remove(writer.temporary_path.c_str());
+        printf("./%s:%d: error: %u of the %u rows of %s were written\n", __FILE__, __LINE__, 
+                    writer.n_written_rows, writer.header.n_rows, writer.binary_path.c_str());
+        exit(1);
+    }
 
-            if(dataset.training_set[training_data_idx][dim_idx] < min){
-                min = dataset.training_set[training_data_idx][dim_idx];
-            }
+    // The header goes last, a file that is cut short is never taken for a complete one
+    writer.header.n_classes = writer.class_counts.size() - std::count(writer.class_counts.begin(), writer.class_counts.end(), 0);
+    WriteAt(writer, writer.min_values.data(), sizeof(float) * writer.header.n_features, sizeof(writer.header));
+    WriteAt(writer, writer.max_values.data(), sizeof(float) * writer.header.n_features, sizeof(writer.header) + sizeof(float) * writer.header.n_features);
+    WriteAt(writer, &writer.header, sizeof(writer.header), 0);
+    if(close(writer.file) != 0 || rename(writer.temporary_path.c_str(), writer.binary_path.c_str()) != 0){
+        remove(writer.temporary_path.c_str());
+        printf("./%s:%d: error: cannot write %s\n", __FILE__, __LINE__, writer.binary_path.c_str());
+        exit(1);
+    }
+    writer.file = -1;
+}
+
+// A row that ParseRow leaves empty
+static bool IsBlankRow(const char *row_begin, const char *row_end)
+{
+    for(const char *cursor = row_begin; cursor < row_end; cursor++){
+        if(!isspace((uint8_t)*cursor) && *cursor != ','){
+            return false;
         }
+    }
+    return true;
+}
+
+#define BINARY_FOLD_BLOCK_BYTES ((size_t)16 << 20) // Rows converted at a time by WriteBinaryFold, in bytes of features
 
-        for(uint32_t testing_data_idx = 0; testing_data_idx < dataset.testing_set.size(); testing_data_idx++)
-        {
-            if(dataset.testing_set[testing_data_idx][dim_idx] > max){
-                max = dataset.testing_set[testing_data_idx][dim_idx];
+void WriteBinaryFold(const std::string &file_path)
+{
+    size_t file_size = 0;
+    const char *buffer = MapTextFile(file_path, file_size);
+    const char *buffer_end = (buffer == NULL)? NULL : buffer + file_size;
+
+    // Count the rows first, the column blocks are placed by the number of rows. Only the first row is parsed
+    uint32_t n_rows = 0, n_features = 0;
+    std::vector<float> data_row;
+    for(const char *cursor = buffer; cursor < buffer_end; ){
+        const char *row_end = (const char*)memchr(cursor, '\n', buffer_end - cursor);
+        if(row_end == NULL){
+            row_end = buffer_end;
+        }
+        if(!IsBlankRow(cursor, row_end)){
+            if(n_rows == 0){
+                ParseRow(cursor, buffer_end, data_row);
+                n_features = data_row.size() - 1;
             }
+            n_rows++;
+        }
+        cursor = row_end + 1;
+    }
+
+    // Then convert a block of rows at a time, so that neither the file nor its rows have to fit in memory
+    BinaryFoldWriter writer;
+    OpenBinaryFoldWriter(writer, BinaryFoldPath(file_path), file_path, n_rows, n_features);
+    const uint32_t block_size = std::max((size_t)1, BINARY_FOLD_BLOCK_BYTES / (sizeof(float) * DataMatrixStride(n_features)));
+    const size_t page_size = sysconf(_SC_PAGESIZE);
+    const char *released_end = buffer;
+    DataMatrix block;
+    InitDataMatrix(block, 0, n_features);
+    for(const char *cursor = buffer; cursor < buffer_end; ){
+        cursor = ParseRow(cursor, buffer_end, data_row);
+        if(data_row.empty()){
+            continue; // Blank line
+        }
+        if(data_row.size() != n_features + 1){
+            remove(writer.temporary_path.c_str());
+            printf("./%s:%d: error: row %u of %s has %zu values, expected %u\n", __FILE__, __LINE__, 
+                        writer.n_written_rows + block.n_samples + 1, file_path.c_str(), data_row.size(), n_features + 1);
+            exit(1);
+        }
+        AppendRow(block, data_row.data(), data_row.back());
 
-            if(dataset.testing_set[testing_data_idx][dim_idx] < min){
-                min = dataset.testing_set[testing_data_idx][dim_idx];
+        if(block.n_samples == block_size){
+            WriteBinaryFoldRows(writer, block, NULL);
+            InitDataMatrix(block, 0, n_features);
+            // The text that has been converted is not read again, let it leave memory
+            const char *page_end = buffer + std::min((size_t)(cursor - buffer), file_size) / page_size * page_size;
+            if(page_end > released_end){
+                madvise((void*)released_end, page_end - released_end, MADV_DONTNEED);
+                released_end = page_end;
             }
         }
-        
-        if(max == min){
-            for(uint32_t training_data_idx = 0; training_data_idx < dataset.training_set.size(); training_data_idx++){
-                (dataset.training_set)[training_data_idx][dim_idx] = 0;
+    }
+    if(block.n_samples > 0){
+        WriteBinaryFoldRows(writer, block, NULL);
+    }
+    if(buffer != NULL){
+        munmap((void*)buffer, file_size);
+    }
+    CloseBinaryFoldWriter(writer);
+}
+
+bool MapBinaryFold(BinaryFold &binary_fold, const std::string &binary_path)
+{
+    int file = open(binary_path.c_str(), O_RDONLY);
+    if(file < 0){
+        return false;
+    }
+    struct stat file_stat;
+    if(fstat(file, &file_stat) != 0 || (size_t)file_stat.st_size < sizeof(BinaryFoldHeader)){
+        close(file);
+        return false;
+    }
+    const size_t file_size = file_stat.st_size;
+    const char *buffer = (const char*)mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if(buffer == MAP_FAILED){
+        return false;
+    }
+
+    const BinaryFoldHeader *header = (const BinaryFoldHeader*)buffer;
+    if(!IsValidBinaryFoldHeader(*header, file_size)){
+        munmap((void*)buffer, file_size);
+        return false;
+    }
+
+    binary_fold.header     = header;
+    binary_fold.min_values = (const float*)(buffer + sizeof(BinaryFoldHeader));
+    binary_fold.max_values = binary_fold.min_values + header->n_features;
+    binary_fold.columns    = (const float*)(buffer + header->columns_offset);
+    binary_fold.labels     = (const uint32_t*)(buffer + header->labels_offset);
+    binary_fold.file_size  = file_size;
+    return true;
+}
+
+void UnmapBinaryFold(BinaryFold &binary_fold)
+{
+    munmap((void*)binary_fold.header, binary_fold.file_size);
+    binary_fold.header = NULL;
+}
+
+void ReadBinaryFold(DataMatrix &matrix, const BinaryFold &binary_fold, FeatureScaler *scaler)
+{
+    const uint32_t n_rows = binary_fold.header->n_rows, n_features = binary_fold.header->n_features;
+    InitDataMatrix(matrix, n_rows, n_features);
+    // Transposed in blocks of rows, so that the rows being filled and the parts of the columns being read stay in cache
+    const uint32_t block_size = 256;
+    for(uint32_t block_begin = 0; block_begin < n_rows; block_begin += block_size){
+        const uint32_t block_end = std::min(block_begin + block_size, n_rows);
+        for(uint32_t feature_idx = 0; feature_idx < n_features; feature_idx++){
+            const float *column = binary_fold.columns + (size_t)feature_idx * binary_fold.header->column_stride;
+            for(uint32_t data_idx = block_begin; data_idx < block_end; data_idx++){
+                matrix.Row(data_idx)[feature_idx] = column[data_idx];
             }
+        }
+    }
+    memcpy(matrix.labels.data(), binary_fold.labels, sizeof(uint32_t) * n_rows);
+
+    if(scaler != NULL && n_rows > 0){
+        PrepareScaler(*scaler, n_features, "binary fold");
+        FitFeatureScalerRange(*scaler, binary_fold.min_values, binary_fold.max_values);
+    }
+}
 
-            for(uint32_t testing_data_idx = 0; testing_data_idx < dataset.testing_set.size(); testing_data_idx++){
-                dataset.testing_set[testing_data_idx][dim_idx] = 0;
-            }  
+static void ReadAt(const BinaryFoldFile &binary_file, void *data, const size_t size, const uint64_t offset)
+{
+    for(size_t n_read = 0; n_read < size; ){
+        const ssize_t n_bytes = pread(binary_file.file, (char*)data + n_read, size - n_read, offset + n_read);
+        if(n_bytes <= 0){
+            printf("./%s:%d: error: read binary fold error\n", __FILE__, __LINE__);
+            exit(1);
         }
-        else{
-            for(uint32_t training_data_idx = 0; training_data_idx < dataset.training_set.size(); training_data_idx++){
-                dataset.training_set[training_data_idx][dim_idx] = (dataset.training_set[training_data_idx][dim_idx] - min) / (max - min);;
-            }
+        n_read += n_bytes;
+    }
+}
 
-            for(uint32_t testing_data_idx = 0; testing_data_idx < dataset.testing_set.size(); testing_data_idx++){
-                dataset.testing_set[testing_data_idx][dim_idx] = (dataset.testing_set[testing_data_idx][dim_idx] - min) / (max - min);
-            }   
+bool OpenBinaryFold(BinaryFoldFile &binary_file, const std::string &binary_path)
+{
+    binary_file.file = open(binary_path.c_str(), O_RDONLY);
+    if(binary_file.file < 0){
+        return false;
+    }
+    struct stat file_stat;
+    if(fstat(binary_file.file, &file_stat) != 0 || (size_t)file_stat.st_size < sizeof(BinaryFoldHeader) || 
+        pread(binary_file.file, &binary_file.header, sizeof(BinaryFoldHeader), 0) != sizeof(BinaryFoldHeader) ||
+        !IsValidBinaryFoldHeader(binary_file.header, file_stat.st_size)){
+        CloseBinaryFold(binary_file);
+        return false;
+    }
+
+    binary_file.min_values.resize(binary_file.header.n_features);
+    binary_file.max_values.resize(binary_file.header.n_features);
+    ReadAt(binary_file, binary_file.min_values.data(), sizeof(float) * binary_file.header.n_features, sizeof(BinaryFoldHeader));
+    ReadAt(binary_file, binary_file.max_values.data(), sizeof(float) * binary_file.header.n_features, 
+                sizeof(BinaryFoldHeader) + sizeof(float) * binary_file.header.n_features);
+    return true;
+}
+
+void CloseBinaryFold(BinaryFoldFile &binary_file)
+{
+    close(binary_file.file);
+    binary_file.file = -1;
+}
+
+void ReadBinaryFoldRows(const BinaryFoldFile &binary_file, const uint32_t begin, const uint32_t end, DataMatrix &block)
+{
+    const BinaryFoldHeader &header = binary_file.header;
+    InitDataMatrix(block, end - begin, header.n_features);
+    std::vector<float> column(end - begin);
+    for(uint32_t feature_idx = 0; feature_idx < header.n_features; feature_idx++){
+        ReadAt(binary_file, column.data(), sizeof(float) * column.size(), 
+                    header.columns_offset + sizeof(float) * ((uint64_t)feature_idx * header.column_stride + begin));
+        for(uint32_t data_idx = 0; data_idx < block.n_samples; data_idx++){
+            block.Row(data_idx)[feature_idx] = column[data_idx];
+        }
+    }
+    ReadAt(binary_file, block.labels.data(), sizeof(uint32_t) * block.n_samples, header.labels_offset + sizeof(uint32_t) * (uint64_t)begin);
+}
+
+void ReadBinaryFoldLabels(const BinaryFoldFile &binary_file, std::vector<uint32_t> &labels)
+{
+    labels.resize(binary_file.header.n_rows);
+    ReadAt(binary_file, labels.data(), sizeof(uint32_t) * labels.size(), binary_file.header.labels_offset);
+}
+
+// Read the binary conversion of file_path when it is up to date or the text file is gone, the text file otherwise
+bool IsConversionOf(const BinaryFoldHeader &header, const std::string &file_path)
+{
+    int64_t mtime_ns = 0;
+    uint64_t size = 0;
+    const bool has_text_file = GetFileVersion(file_path, mtime_ns, size);
+    return !has_text_file || (mtime_ns == header.source_mtime_ns && size == header.source_size);
+}
+
+static void ReadFoldFile(DataMatrix &matrix, const std::string &file_path, FeatureScaler &scaler)
+{
+    BinaryFold binary_fold;
+    if(MapBinaryFold(binary_fold, BinaryFoldPath(file_path))){
+        if(IsConversionOf(*binary_fold.header, file_path)){
+            ReadBinaryFold(matrix, binary_fold, &scaler);
+            UnmapBinaryFold(binary_fold);
+            return;
         }
+        UnmapBinaryFold(binary_fold);
     }
+    ReadDataMatrix(matrix, file_path, &scaler);
 }
 
 Dataset ReadTrainingAndTestingSet(const std::string training_path, const std::string testing_path)
 {
-    // Read training and testing set respectively
+    // Read training and testing set respectively, the range of every feature is taken across both
     Dataset dataset;
-    ReadDataset(dataset.training_set, training_path);
-    ReadDataset(dataset.testing_set,  testing_path);  
+    ReadFoldFile(dataset.training_set, training_path, dataset.scaler);
+    ReadFoldFile(dataset.testing_set,  testing_path, dataset.scaler);  
 
-    GetNumClasses(dataset);
-    Normalize(dataset);
+    GetClassStatistics(dataset);
+    ScaleDataMatrix(dataset.scaler, dataset.training_set);
+    ScaleDataMatrix(dataset.scaler, dataset.testing_set);
     return dataset;
-} 
+}
+
+// Convert file_path to binary unless its conversion is up to date, the text file is gone or its directory is read-only
+static void UpdateBinaryFold(const std::string &file_path)
+{
+    int64_t mtime_ns = 0;
+    uint64_t size = 0;
+    if(!GetFileVersion(file_path, mtime_ns, size)){
+        return;
+    }
+    BinaryFold binary_fold;
+    if(MapBinaryFold(binary_fold, BinaryFoldPath(file_path))){
+        const bool is_conversion = IsConversionOf(*binary_fold.header, file_path);
+        UnmapBinaryFold(binary_fold);
+        if(is_conversion){
+            return;
+        }
+    }
+    const size_t separator_idx = file_path.find_last_of('/');
+    const std::string directory = (separator_idx == std::string::npos)? "." : file_path.substr(0, separator_idx + 1);
+    if(access(directory.c_str(), W_OK) != 0){
+        return; // The dataset directory may be read-only, the in-process cache still works
+    }
+    WriteBinaryFold(file_path);
+}
+
+// A fold of ReadCachedTrainingAndTestingSet, parsed by the first caller that asks for it
+typedef struct CachedFold{
+    std::once_flag is_read;
+    Dataset dataset;
+}CachedFold;
+
+static void ReadFold(const std::string &training_path, const std::string &testing_path, const bool use_disk_cache, Dataset &fold)
+{
+    if(use_disk_cache){
+        UpdateBinaryFold(training_path);
+        UpdateBinaryFold(testing_path);
+    }
+    fold = ReadTrainingAndTestingSet(training_path, testing_path);
+}
+
+// Folds of ReadCachedTrainingAndTestingSet by (training path, testing path), the lock only guards the map
+static std::mutex cached_folds_mutex;
+static std::map<std::pair<std::string, std::string>, std::unique_ptr<CachedFold>> cached_folds;
+
+const Dataset& ReadCachedTrainingAndTestingSet(const std::string &training_path, const std::string &testing_path, const bool use_disk_cache)
+{
+    // Different folds are read at the same time
+    CachedFold *fold = NULL;
+    {
+        std::lock_guard<std::mutex> lock(cached_folds_mutex);
+        std::unique_ptr<CachedFold> &cached_fold = cached_folds[std::make_pair(training_path, testing_path)];
+        if(!cached_fold){
+            cached_fold.reset(new CachedFold);
+        }
+        fold = cached_fold.get();
+    }
+    std::call_once(fold->is_read, ReadFold, std::cref(training_path), std::cref(testing_path), use_disk_cache, std::ref(fold->dataset));
+    return fold->dataset;
+}
+
+void ReleaseCachedTrainingAndTestingSet(const std::string &training_path, const std::string &testing_path)
+{
+    std::unique_ptr<CachedFold> released_fold;
+    {
+        std::lock_guard<std::mutex> lock(cached_folds_mutex);
+        auto fold_it = cached_folds.find(std::make_pair(training_path, testing_path));
+        if(fold_it == cached_folds.end()){
+            return;
+        }
+        released_fold.swap(fold_it->second);
+        cached_folds.erase(fold_it);
+    }
+    // The fold is freed here, outside the lock
+}
+
+std::vector<uint32_t> SelectedIdxes(const std::vector<bool> &is_selected)
+{
+    std::vector<uint32_t> selected_idxes;
+    selected_idxes.reserve(std::count(is_selected.begin(), is_selected.end(), true));
+    for(uint32_t data_idx = 0; data_idx < is_selected.size(); data_idx++){
+        if(is_selected[data_idx]){
+            selected_idxes.push_back(data_idx);
+        }
+    }
+    return selected_idxes;
+}
@@ -0,0 +1,658 @@
+#include "../inc/nearest_neighbors.h"
+
+#define QUERY_BLOCK_SIZE 8   // Queries that share one pass over a tile of points
+#define POINT_TILE_SIZE  1024 // Points per tile, a multiple of 8
+#define QUERY_CHUNK_SIZE 256  // Queries per thread pool task, a multiple of QUERY_BLOCK_SIZE
+#define KD_TREE_LEAF_SIZE 16  // A node with at most this many points is not split
+#define KD_TREE_MAX_FEATURES 10  // Above this the tree visits most leaves of uniformly spread points anyway
+#define KD_TREE_MIN_POINTS_PER_CELL 4 // The tree pays off once n_points >= KD_TREE_MIN_POINTS_PER_CELL * k * 2^n_features
+#define RP_TREE_LEAF_SIZE 32  // A random projection tree node with at most this many points is not split
+#define RP_FOREST_SEED 5489   // Trees are seeded with RP_FOREST_SEED + tree index, so the forest is reproducible
+#define RP_FOREST_SEARCH_FACTOR 2 // A query visits leaves until it has n_trees * max(k, RP_TREE_LEAF_SIZE) * factor candidates
+
+PointSet MatrixPoints(const DataMatrix &matrix, const std::vector<uint32_t> *row_idxes)
+{
+    if(row_idxes == NULL){
+        return {matrix.features.data(), matrix.stride, NULL, matrix.n_samples, matrix.n_features};
+    }
+    return {matrix.features.data(), matrix.stride, row_idxes->data(), (uint32_t)row_idxes->size(), matrix.n_features};
+}
+
+PointSet PackedPoints(const float *points, const uint32_t n_points, const uint32_t n_features)
+{
+    return {points, n_features, NULL, n_points, n_features};
+}
+
+// Candidates of one query, sorted by (squared distance, index), at most k of them
+typedef struct TopK{
+    uint32_t k;
+    uint32_t size;
+    float *square_distances;
+    uint32_t *idxes;
+}TopK;
+
+// Candidates are ordered by (squared distance, index), so the result does not depend on the visiting order
+static inline bool IsCloser(const float square_distance, const uint32_t point_idx, const float other_square_distance, const uint32_t other_point_idx)
+{
+    return square_distance < other_square_distance || (square_distance == other_square_distance && point_idx < other_point_idx);
+}
+
+static inline bool IsCandidate(const TopK &top_k, const float square_distance, const uint32_t point_idx)
+{
+    return top_k.size < top_k.k || IsCloser(square_distance, point_idx, top_k.square_distances[top_k.k - 1], top_k.idxes[top_k.k - 1]);
+}
+
+// The caller checks IsCandidate first
+static void PushCandidate(TopK &top_k, const float square_distance, const uint32_t point_idx)
+{
+    uint32_t position = (top_k.size < top_k.k)? top_k.size++ : top_k.k - 1;
+    while(position > 0 && IsCloser(square_distance, point_idx, top_k.square_distances[position - 1], top_k.idxes[position - 1])){
+        top_k.square_distances[position] = top_k.square_distances[position - 1];
+        top_k.idxes[position] = top_k.idxes[position - 1];
+        position--;
+    }
+    top_k.square_distances[position] = square_distance;
+    top_k.idxes[position] = point_idx;
+}
+
+// Random projection tree, points of a node are split at the median of their projections on a random direction
+typedef struct RPTreeNode{
+    uint32_t begin;         // The node holds RPTree::point_idxes[begin ... end)
+    uint32_t end;
+    uint32_t normal_offset; // The direction is RPTree::normals[normal_offset ... normal_offset + n_features)
+    float split_value;      // Projections of the left child are <= split_value, projections of the right child are >=
+    uint32_t left_child;    // 0 for a leaf
+    uint32_t right_child;
+}RPTreeNode;
+
+typedef struct RPTree{
+    std::vector<uint32_t> point_idxes;
+    std::vector<float> normals;
+    std::vector<RPTreeNode> nodes;
+}RPTree;
+
+// Squared distances from query to the points [begin, end) of the tile, begin and end are multiples of 8
+static void SquareDistancesScalar(const PointColumns &point_columns, const float *query, const uint32_t begin, const uint32_t end, float *square_distances)
+{
+    for(uint32_t point_idx = begin; point_idx < end; point_idx++){
+        square_distances[point_idx - begin] = 0.f;
+    }
+    for(uint32_t feature_idx = 0; feature_idx < point_columns.n_features; feature_idx++){
+        const float *column = &point_columns.values[(size_t)feature_idx * point_columns.stride];
+        const float query_value = query[feature_idx];
+        for(uint32_t point_idx = begin; point_idx < end; point_idx++){
+            float diff = column[point_idx] - query_value;
+            square_distances[point_idx - begin] += diff * diff;
+        }
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// Separate multiply and add (no FMA), so every lane rounds exactly like SquareDistancesScalar
+__attribute__((target("avx2")))
+static void SquareDistancesAvx2(const PointColumns &point_columns, const float *query, const uint32_t begin, const uint32_t end, float *square_distances)
+{
+    const uint32_t n_features = point_columns.n_features;
+    const float *values = point_columns.values.data();
+    const size_t stride = point_columns.stride;
+    uint32_t point_idx = begin;
+    for(; point_idx + 32 <= end; point_idx += 32){
+        __m256 sums[4] = {_mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps()};
+        for(uint32_t feature_idx = 0; feature_idx < n_features; feature_idx++){
+            const float *column = values + feature_idx * stride + point_idx;
+            const __m256 query_value = _mm256_set1_ps(query[feature_idx]);
+            for(uint32_t lane_block = 0; lane_block < 4; lane_block++){
+                __m256 diff = _mm256_sub_ps(_mm256_loadu_ps(column + lane_block * 8), query_value);
+                sums[lane_block] = _mm256_add_ps(sums[lane_block], _mm256_mul_ps(diff, diff));
+            }
+        }
+        for(uint32_t lane_block = 0; lane_block < 4; lane_block++){
+            _mm256_storeu_ps(square_distances + point_idx - begin + lane_block * 8, sums[lane_block]);
+        }
+    }
+    for(; point_idx < end; point_idx += 8){
+        __m256 sum = _mm256_setzero_ps();
+        for(uint32_t feature_idx = 0; feature_idx < n_features; feature_idx++){
+            __m256 diff = _mm256_sub_ps(_mm256_loadu_ps(values + feature_idx * stride + point_idx), _mm256_set1_ps(query[feature_idx]));
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(diff, diff));
+        }
+        _mm256_storeu_ps(square_distances + point_idx - begin, sum);
+    }
+}
+#endif
+
+typedef void (*SquareDistancesFunction)(const PointColumns&, const float*, const uint32_t, const uint32_t, float*);
+
+// Brute force k nearest neighbours of the queries [query_begin, query_end), neighbor_lists.offsets is already set
+static void FindKNearestNeighborsBruteForce(const PointColumns &point_columns, SquareDistancesFunction SquareDistances, const PointSet &queries, 
+                                                const uint32_t query_begin, const uint32_t query_end, NeighborLists &neighbor_lists)
+{
+    const uint32_t n_points = point_columns.n_points;
+
+    // The candidates are kept in place in the output arrays
+    std::vector<float> square_distances(POINT_TILE_SIZE);
+    for(uint32_t block_begin = query_begin; block_begin < query_end; block_begin += QUERY_BLOCK_SIZE){
+        const uint32_t block_end = std::min(block_begin + QUERY_BLOCK_SIZE, query_end);
+        TopK top_ks[QUERY_BLOCK_SIZE];
+        for(uint32_t query_idx = block_begin; query_idx < block_end; query_idx++){
+            const uint32_t offset = neighbor_lists.offsets[query_idx];
+            top_ks[query_idx - block_begin] = {neighbor_lists.offsets[query_idx + 1] - offset, 0,
+                                                neighbor_lists.distances.data() + offset, neighbor_lists.idxes.data() + offset};
+        }
+
+        for(uint32_t tile_begin = 0; tile_begin < point_columns.stride; tile_begin += POINT_TILE_SIZE){
+            const uint32_t tile_end = std::min(tile_begin + POINT_TILE_SIZE, point_columns.stride);
+            const uint32_t n_tile_points = std::min(tile_end, n_points) - tile_begin;
+            for(uint32_t query_idx = block_begin; query_idx < block_end; query_idx++){
+                TopK &top_k = top_ks[query_idx - block_begin];
+                if(top_k.k == 0){
+                    continue;
+                }
+                SquareDistances(point_columns, queries.Point(query_idx), tile_begin, tile_end, square_distances.data());
+                for(uint32_t tile_point_idx = 0; tile_point_idx < n_tile_points; tile_point_idx++){
+                    if(IsCandidate(top_k, square_distances[tile_point_idx], tile_begin + tile_point_idx)){
+                        PushCandidate(top_k, square_distances[tile_point_idx], tile_begin + tile_point_idx);
+                    }
+                }
+            }
+        }
+
+        // Only the survivors pay for a square root
+        for(uint32_t neighbor_idx = neighbor_lists.offsets[block_begin]; neighbor_idx < neighbor_lists.offsets[block_end]; neighbor_idx++){
+            neighbor_lists.distances[neighbor_idx] = sqrt(neighbor_lists.distances[neighbor_idx]);
+        }
+    }
+}
+
+// Same summation order as SquareDistancesScalar
+static inline float SquareDistance(const float *src, const float *dst, const uint32_t n_features)
+{
+    float square_distance = 0.f;
+    for(uint32_t feature_idx = 0; feature_idx < n_features; feature_idx++){
+        float diff = src[feature_idx] - dst[feature_idx];
+        square_distance += diff * diff;
+    }
+    return square_distance;
+}
+
+bool IsKDTreeWorthwhile(const uint32_t n_points, const uint32_t n_features, const uint32_t k)
+{
+    if(n_features > KD_TREE_MAX_FEATURES || n_points <= KD_TREE_LEAF_SIZE){
+        return false;
+    }
+    // A query visits leaves until it holds k candidates, and every tie at the k-th distance keeps the far side open,
+    // while the scan costs the same for any k
+    return (uint64_t)n_points >= ((uint64_t)KD_TREE_MIN_POINTS_PER_CELL * std::max(k, (uint32_t)1) << n_features);
+}
+
+// Split the points [begin, end) of tree.points at the median of the feature with the widest spread
+static uint32_t BuildKDTreeNode(KDTree &tree, const uint32_t begin, const uint32_t end)
+{
+    const uint32_t node_idx = tree.nodes.size();
+    tree.nodes.push_back({begin, end, 0, 0.f, 0, 0});
+    if(end - begin <= KD_TREE_LEAF_SIZE){
+        return node_idx;
+    }
+
+    const uint32_t n_features = tree.n_features;
+    uint32_t split_feature = 0;
+    float widest_spread = -1.f;
+    for(uint32_t feature_idx = 0; feature_idx < n_features; feature_idx++){
+        float min_value = std::numeric_limits<float>::infinity(), max_value = -std::numeric_limits<float>::infinity();
+        for(uint32_t point_idx = begin; point_idx < end; point_idx++){
+            float value = tree.points[(size_t)tree.point_idxes[point_idx] * n_features + feature_idx];
+            min_value = std::min(min_value, value);
+            max_value = std::max(max_value, value);
+        }
+        if(max_value - min_value > widest_spread){
+            widest_spread = max_value - min_value;
+            split_feature = feature_idx;
+        }
+    }
+    if(widest_spread <= 0.f){
+        return node_idx; // Every point is a duplicate
+    }
+
+    // Left points are <= split_value and right points are >= split_value
+    const uint32_t middle = begin + (end - begin) / 2;
+    const float *points = tree.points.data();
+    std::nth_element(tree.point_idxes.begin() + begin, tree.point_idxes.begin() + middle, tree.point_idxes.begin() + end,
+                        [points, n_features, split_feature](const uint32_t a, const uint32_t b){
+                            return points[(size_t)a * n_features + split_feature] < points[(size_t)b * n_features + split_feature];
+                        });
+    tree.nodes[node_idx].split_feature = split_feature;
+    tree.nodes[node_idx].split_value = points[(size_t)tree.point_idxes[middle] * n_features + split_feature];
+
+    const uint32_t left_child = BuildKDTreeNode(tree, begin, middle);
+    const uint32_t right_child = BuildKDTreeNode(tree, middle, end);
+    tree.nodes[node_idx].left_child = left_child;
+    tree.nodes[node_idx].right_child = right_child;
+    return node_idx;
+}
+
+void BuildKDTree(const PointSet &points, KDTree &tree)
+{
+    const uint32_t n_points = points.n_points, n_features = points.n_features;
+    tree.n_features = n_features;
+    tree.points.resize((size_t)n_points * n_features);
+    for(uint32_t point_idx = 0; point_idx < n_points; point_idx++){
+        memcpy(&tree.points[(size_t)point_idx * n_features], points.Point(point_idx), n_features * sizeof(float));
+    }
+    tree.point_idxes.resize(n_points);
+    std::iota(tree.point_idxes.begin(), tree.point_idxes.end(), 0);
+    tree.nodes.clear();
+    if(n_points > 0){
+        BuildKDTreeNode(tree, 0, n_points);
+    }
+
+    // Store the points in leaf order, so a leaf scans one contiguous block
+    std::vector<float> leaf_ordered_points((size_t)n_points * n_features);
+    for(uint32_t point_idx = 0; point_idx < n_points; point_idx++){
+        memcpy(&leaf_ordered_points[(size_t)point_idx * n_features], &tree.points[(size_t)tree.point_idxes[point_idx] * n_features], n_features * sizeof(float));
+    }
+    tree.points.swap(leaf_ordered_points);
+}
+
+// The far child of a node is only visited if the splitting plane is not farther than the current worst candidate.
+// fl(query - split_value)^2 never exceeds the squared distance to a point beyond the plane, because float subtraction,
+// squaring and summing of non-negative terms are all monotone, so the pruning never drops a true neighbour.
+static void SearchKDTree(const KDTree &tree, const uint32_t node_idx, const float *query, TopK &top_k)
+{
+    const KDTreeNode &node = tree.nodes[node_idx];
+    const uint32_t n_features = tree.n_features;
+    if(node.left_child == 0){
+        for(uint32_t point_idx = node.begin; point_idx < node.end; point_idx++){
+            float square_distance = SquareDistance(&tree.points[(size_t)point_idx * n_features], query, n_features);
+            if(IsCandidate(top_k, square_distance, tree.point_idxes[point_idx])){
+                PushCandidate(top_k, square_distance, tree.point_idxes[point_idx]);
+            }
+        }
+        return;
+    }
+
+    float diff = query[node.split_feature] - node.split_value;
+    const bool is_left_first = diff < 0.f;
+    SearchKDTree(tree, is_left_first? node.left_child : node.right_child, query, top_k);
+    if(top_k.size < top_k.k || diff * diff <= top_k.square_distances[top_k.k - 1]){
+        SearchKDTree(tree, is_left_first? node.right_child : node.left_child, query, top_k);
+    }
+}
+
+static void SearchKDTreeInRadius(const KDTree &tree, const uint32_t node_idx, const float *query, const float square_radius,
+                                    std::vector<std::pair<float, uint32_t>> &neighbors)
+{
+    const KDTreeNode &node = tree.nodes[node_idx];
+    const uint32_t n_features = tree.n_features;
+    if(node.left_child == 0){
+        for(uint32_t point_idx = node.begin; point_idx < node.end; point_idx++){
+            float square_distance = SquareDistance(&tree.points[(size_t)point_idx * n_features], query, n_features);
+            if(square_distance <= square_radius){
+                neighbors.push_back({square_distance, tree.point_idxes[point_idx]});
+            }
+        }
+        return;
+    }
+
+    float diff = query[node.split_feature] - node.split_value;
+    if(diff <= 0.f || diff * diff <= square_radius){
+        SearchKDTreeInRadius(tree, node.left_child, query, square_radius, neighbors);
+    }
+    if(diff >= 0.f || diff * diff <= square_radius){
+        SearchKDTreeInRadius(tree, node.right_child, query, square_radius, neighbors);
+    }
+}
+
+void QueryKDTree(const KDTree &tree, const float *query, const uint32_t k, uint32_t *neighbor_idxes, float *neighbor_distances)
+{
+    TopK top_k = {std::min(k, (uint32_t)tree.point_idxes.size()), 0, neighbor_distances, neighbor_idxes};
+    if(top_k.k > 0){
+        SearchKDTree(tree, 0, query, top_k);
+    }
+    for(uint32_t neighbor_idx = 0; neighbor_idx < top_k.size; neighbor_idx++){
+        neighbor_distances[neighbor_idx] = sqrt(neighbor_distances[neighbor_idx]);
+    }
+}
+
+// Run body(query_begin, query_end) for chunks of QUERY_CHUNK_SIZE queries on GetThreadPool(n_threads)
+// Every chunk of queries writes its own slice of the output, so the tasks share nothing mutable
+static void ForEachQueryChunk(const uint32_t n_queries, const uint32_t n_threads, const std::function<void(uint32_t, uint32_t)> &body)
+{
+    const uint32_t n_chunks = (n_queries + QUERY_CHUNK_SIZE - 1) / QUERY_CHUNK_SIZE;
+    auto run_chunk = [n_queries, &body](uint32_t chunk_idx){
+        body(chunk_idx * QUERY_CHUNK_SIZE, std::min((chunk_idx + 1) * QUERY_CHUNK_SIZE, n_queries));
+    };
+    if(n_threads == 1){
+        for(uint32_t chunk_idx = 0; chunk_idx < n_chunks; chunk_idx++){
+            run_chunk(chunk_idx);
+        }
+    }
+    else{
+        GetThreadPool(n_threads).ParallelFor(n_chunks, run_chunk);
+    }
+}
+
+// Offsets of min(ks[q], n_points) neighbours per query, and room for them
+static void AllocateNeighborLists(const uint32_t n_points, const uint32_t n_queries, const uint32_t *ks, NeighborLists &neighbor_lists)
+{
+    neighbor_lists.offsets.resize(n_queries + 1);
+    neighbor_lists.offsets[0] = 0;
+    for(uint32_t query_idx = 0; query_idx < n_queries; query_idx++){
+        neighbor_lists.offsets[query_idx + 1] = neighbor_lists.offsets[query_idx] + std::min(ks[query_idx], n_points);
+    }
+    neighbor_lists.idxes.resize(neighbor_lists.offsets[n_queries]);
+    neighbor_lists.distances.resize(neighbor_lists.offsets[n_queries]);
+}
+
+void BuildNeighborIndex(const PointSet &points, const uint32_t max_k, NeighborIndex &index)
+{
+    const uint32_t n_points = points.n_points, n_features = points.n_features;
+    index.n_points    = n_points;
+    index.use_kd_tree = IsKDTreeWorthwhile(n_points, n_features, max_k);
+    if(index.use_kd_tree){
+        BuildKDTree(points, index.kd_tree);
+        index.point_columns = PointColumns();
+        return;
+    }
+    index.kd_tree = KDTree();
+
+    // Padding points sit at +inf and are dropped by their index
+    PointColumns &point_columns = index.point_columns;
+    point_columns.n_points   = n_points;
+    point_columns.n_features = n_features;
+    point_columns.stride     = (n_points + 7) / 8 * 8;
+    point_columns.values.assign((size_t)n_features * point_columns.stride, std::numeric_limits<float>::infinity());
+    for(uint32_t point_idx = 0; point_idx < n_points; point_idx++){
+        const float *point = points.Point(point_idx);
+        for(uint32_t feature_idx = 0; feature_idx < n_features; feature_idx++){
+            point_columns.values[(size_t)feature_idx * point_columns.stride + point_idx] = point[feature_idx];
+        }
+    }
+}
+
+void QueryNeighborIndex(const NeighborIndex &index, const PointSet &queries, const uint32_t *ks, const uint32_t n_threads, 
+                            NeighborLists &neighbor_lists)
+{
+    const uint32_t n_queries = queries.n_points;
+    AllocateNeighborLists(index.n_points, n_queries, ks, neighbor_lists);
+
+    if(index.use_kd_tree){
+        const KDTree &tree = index.kd_tree;
+        ForEachQueryChunk(n_queries, n_threads, [&tree, &queries, &neighbor_lists](uint32_t query_begin, uint32_t query_end){
+            for(uint32_t query_idx = query_begin; query_idx < query_end; query_idx++){
+                const uint32_t offset = neighbor_lists.offsets[query_idx];
+                QueryKDTree(tree, queries.Point(query_idx), neighbor_lists.offsets[query_idx + 1] - offset, 
+                                &neighbor_lists.idxes[offset], &neighbor_lists.distances[offset]);
+            }
+        });
+        return;
+    }
+
+    SquareDistancesFunction SquareDistances = SquareDistancesScalar;
+#if defined(__x86_64__) || defined(__i386__)
+    if(__builtin_cpu_supports("avx2")){
+        SquareDistances = SquareDistancesAvx2;
+    }
+#endif
+
+    const PointColumns &point_columns = index.point_columns;
+    ForEachQueryChunk(n_queries, n_threads, [&point_columns, SquareDistances, &queries, &neighbor_lists](uint32_t query_begin, uint32_t query_end){
+        FindKNearestNeighborsBruteForce(point_columns, SquareDistances, queries, query_begin, query_end, neighbor_lists);
+    });
+}
+
+void FindKNearestNeighbors(const PointSet &points, const PointSet &queries, const uint32_t *ks, const uint32_t n_threads, 
+                            NeighborLists &neighbor_lists)
+{
+    const uint32_t max_k = (queries.n_points > 0)? *std::max_element(ks, ks + queries.n_points) : 0;
+    NeighborIndex index;
+    BuildNeighborIndex(points, max_k, index);
+    QueryNeighborIndex(index, queries, ks, n_threads, neighbor_lists);
+}
+
+void ReverseNeighborLists(const NeighborLists &neighbor_lists, const uint32_t n_points, NeighborLists &reverse_neighbor_lists)
+{
+    const uint32_t n_queries = neighbor_lists.offsets.size() - 1;
+    const uint32_t n_edges = neighbor_lists.idxes.size();
+
+    // Counting sort of the edges by point, visiting queries in increasing order keeps every list sorted by query index
+    reverse_neighbor_lists.offsets.assign(n_points + 1, 0);
+    for(uint32_t edge_idx = 0; edge_idx < n_edges; edge_idx++){
+        reverse_neighbor_lists.offsets[neighbor_lists.idxes[edge_idx] + 1]++;
+    }
+    for(uint32_t point_idx = 0; point_idx < n_points; point_idx++){
+        reverse_neighbor_lists.offsets[point_idx + 1] += reverse_neighbor_lists.offsets[point_idx];
+    }
+
+    std::vector<uint32_t> next_positions(reverse_neighbor_lists.offsets.begin(), reverse_neighbor_lists.offsets.end() - 1);
+    reverse_neighbor_lists.idxes.resize(n_edges);
+    reverse_neighbor_lists.distances.resize(n_edges);
+    for(uint32_t query_idx = 0; query_idx < n_queries; query_idx++){
+        for(uint32_t edge_idx = neighbor_lists.offsets[query_idx]; edge_idx < neighbor_lists.offsets[query_idx + 1]; edge_idx++){
+            const uint32_t position = next_positions[neighbor_lists.idxes[edge_idx]]++;
+            reverse_neighbor_lists.idxes[position] = query_idx;
+            reverse_neighbor_lists.distances[position] = neighbor_lists.distances[edge_idx];
+        }
+    }
+}
+
+void FindNeighborsInRadius(const PointSet &points, const PointSet &queries, const float radius, const uint32_t n_threads, 
+                            NeighborLists &neighbor_lists)
+{
+    const uint32_t n_points = points.n_points, n_queries = queries.n_points, n_features = points.n_features;
+    const float square_radius = radius * radius;
+    const bool use_kd_tree = IsKDTreeWorthwhile(n_points, n_features, 1);
+    KDTree tree;
+    if(use_kd_tree){
+        BuildKDTree(points, tree);
+    }
+
+    // The number of neighbours of a query is only known once it is answered, so every chunk fills lists of its own
+    std::vector<NeighborLists> chunk_neighbor_lists((n_queries + QUERY_CHUNK_SIZE - 1) / QUERY_CHUNK_SIZE);
+    ForEachQueryChunk(n_queries, n_threads, [&](uint32_t query_begin, uint32_t query_end){
+        NeighborLists &chunk_lists = chunk_neighbor_lists[query_begin / QUERY_CHUNK_SIZE];
+        chunk_lists.offsets.assign(1, 0);
+        std::vector<std::pair<float, uint32_t>> neighbors;
+        for(uint32_t query_idx = query_begin; query_idx < query_end; query_idx++){
+            const float *query = queries.Point(query_idx);
+            neighbors.clear();
+            if(use_kd_tree){
+                SearchKDTreeInRadius(tree, 0, query, square_radius, neighbors);
+            }
+            else{
+                for(uint32_t point_idx = 0; point_idx < n_points; point_idx++){
+                    float square_distance = SquareDistance(points.Point(point_idx), query, n_features);
+                    if(square_distance <= square_radius){
+                        neighbors.push_back({square_distance, point_idx});
+                    }
+                }
+            }
+
+            std::sort(neighbors.begin(), neighbors.end());
+            for(const std::pair<float, uint32_t> &neighbor : neighbors){
+                chunk_lists.idxes.push_back(neighbor.second);
+                chunk_lists.distances.push_back(sqrt(neighbor.first));
+            }
+            chunk_lists.offsets.push_back(chunk_lists.idxes.size());
+        }
+    });
+
+    neighbor_lists.offsets.assign(1, 0);
+    neighbor_lists.idxes.clear();
+    neighbor_lists.distances.clear();
+    for(const NeighborLists &chunk_lists : chunk_neighbor_lists){
+        const uint32_t chunk_offset = neighbor_lists.idxes.size();
+        for(uint32_t chunk_query_idx = 1; chunk_query_idx < chunk_lists.offsets.size(); chunk_query_idx++){
+            neighbor_lists.offsets.push_back(chunk_offset + chunk_lists.offsets[chunk_query_idx]);
+        }
+        neighbor_lists.idxes.insert(neighbor_lists.idxes.end(), chunk_lists.idxes.begin(), chunk_lists.idxes.end());
+        neighbor_lists.distances.insert(neighbor_lists.distances.end(), chunk_lists.distances.begin(), chunk_lists.distances.end());
+    }
+}
+
+static inline float Projection(const float *normal, const float *point, const uint32_t n_features)
+{
+    float projection = 0.f;
+    for(uint32_t feature_idx = 0; feature_idx < n_features; feature_idx++){
+        projection += normal[feature_idx] * point[feature_idx];
+    }
+    return projection;
+}
+
+static uint32_t BuildRPTreeNode(const PointSet &points, RPTree &tree, const uint32_t begin, const uint32_t end, 
+                                    std::mt19937 &gen, std::vector<float> &projections)
+{
+    const uint32_t n_features = points.n_features;
+    const uint32_t node_idx = tree.nodes.size();
+    tree.nodes.push_back({begin, end, 0, 0.f, 0, 0});
+    if(end - begin <= RP_TREE_LEAF_SIZE){
+        return node_idx;
+    }
+
+    const uint32_t normal_offset = tree.normals.size();
+    std::normal_distribution<float> distrib(0.f, 1.f);
+    float square_norm = 0.f;
+    for(uint32_t feature_idx = 0; feature_idx < n_features; feature_idx++){
+        tree.normals.push_back(distrib(gen));
+        square_norm += tree.normals.back() * tree.normals.back();
+    }
+    // Unit directions, so margins of different nodes are comparable distances
+    for(uint32_t feature_idx = 0; feature_idx < n_features; feature_idx++){
+        tree.normals[normal_offset + feature_idx] /= sqrt(square_norm);
+    }
+    const float *normal = &tree.normals[normal_offset];
+    float min_projection = std::numeric_limits<float>::infinity(), max_projection = -std::numeric_limits<float>::infinity();
+    for(uint32_t point_idx = begin; point_idx < end; point_idx++){
+        projections[tree.point_idxes[point_idx]] = Projection(normal, points.Point(tree.point_idxes[point_idx]), n_features);
+        min_projection = std::min(min_projection, projections[tree.point_idxes[point_idx]]);
+        max_projection = std::max(max_projection, projections[tree.point_idxes[point_idx]]);
+    }
+    if(max_projection <= min_projection){
+        tree.normals.resize(normal_offset);
+        return node_idx; // Every point is a duplicate
+    }
+
+    const uint32_t middle = begin + (end - begin) / 2;
+    std::nth_element(tree.point_idxes.begin() + begin, tree.point_idxes.begin() + middle, tree.point_idxes.begin() + end,
+                        [&projections](const uint32_t a, const uint32_t b){return projections[a] < projections[b];});
+    tree.nodes[node_idx].normal_offset = normal_offset;
+    tree.nodes[node_idx].split_value = projections[tree.point_idxes[middle]];
+
+    const uint32_t left_child = BuildRPTreeNode(points, tree, begin, middle, gen, projections);
+    const uint32_t right_child = BuildRPTreeNode(points, tree, middle, end, gen, projections);
+    tree.nodes[node_idx].left_child = left_child;
+    tree.nodes[node_idx].right_child = right_child;
+    return node_idx;
+}
+
+// Candidates come from the leaves of every tree, best first by the smallest margin to a splitting plane on the way down
+static void QueryRPForest(const std::vector<RPTree> &forest, const PointSet &points, const float *query, 
+                            const uint32_t search_k, const uint32_t query_stamp, std::vector<uint32_t> &visit_stamps, 
+                            std::vector<uint32_t> &candidates, std::vector<std::pair<float, uint32_t>> &scored_candidates, TopK &top_k)
+{
+    const uint32_t n_features = points.n_features;
+    // (priority, tree index, node index), larger priorities first
+    std::priority_queue<std::pair<float, std::pair<uint32_t, uint32_t>>> nodes_to_visit;
+    for(uint32_t tree_idx = 0; tree_idx < forest.size(); tree_idx++){
+        nodes_to_visit.push({std::numeric_limits<float>::infinity(), {tree_idx, 0}});
+    }
+
+    candidates.clear();
+    while(!nodes_to_visit.empty() && candidates.size() < search_k){
+        const float priority = nodes_to_visit.top().first;
+        const RPTree &tree = forest[nodes_to_visit.top().second.first];
+        const RPTreeNode &node = tree.nodes[nodes_to_visit.top().second.second];
+        const uint32_t tree_idx = nodes_to_visit.top().second.first;
+        nodes_to_visit.pop();
+        if(node.left_child == 0){
+            for(uint32_t point_idx = node.begin; point_idx < node.end; point_idx++){
+                const uint32_t candidate_idx = tree.point_idxes[point_idx];
+                if(visit_stamps[candidate_idx] != query_stamp){
+                    visit_stamps[candidate_idx] = query_stamp;
+                    candidates.push_back(candidate_idx);
+                }
+            }
+            continue;
+        }
+        float margin = Projection(&tree.normals[node.normal_offset], query, n_features) - node.split_value;
+        nodes_to_visit.push({std::min(priority, margin), {tree_idx, node.right_child}});
+        nodes_to_visit.push({std::min(priority, -margin), {tree_idx, node.left_child}});
+    }
+
+    // Thousands of candidates compete for large k, so select with nth_element instead of one insertion each
+    scored_candidates.clear();
+    for(const uint32_t candidate_idx : candidates){
+        scored_candidates.push_back({SquareDistance(points.Point(candidate_idx), query, n_features), candidate_idx});
+    }
+    top_k.size = std::min(top_k.k, (uint32_t)scored_candidates.size());
+    std::nth_element(scored_candidates.begin(), scored_candidates.begin() + top_k.size - 1, scored_candidates.end());
+    std::sort(scored_candidates.begin(), scored_candidates.begin() + top_k.size);
+    for(uint32_t neighbor_idx = 0; neighbor_idx < top_k.size; neighbor_idx++){
+        top_k.square_distances[neighbor_idx] = scored_candidates[neighbor_idx].first;
+        top_k.idxes[neighbor_idx] = scored_candidates[neighbor_idx].second;
+    }
+}
+
+void FindApproximateKNearestNeighbors(const PointSet &points, const PointSet &queries, const uint32_t *ks, const uint32_t n_trees, 
+                                        const uint32_t n_threads, NeighborLists &neighbor_lists)
+{
+    const uint32_t n_points = points.n_points, n_queries = queries.n_points;
+    AllocateNeighborLists(n_points, n_queries, ks, neighbor_lists);
+    if(n_points == 0 || n_trees == 0){
+        printf("./%s:%d: error: random projection forest needs points and trees\n", __FILE__, __LINE__);
+        exit(1);
+    }
+
+    // Every tree has its own generator, so the forest does not depend on the number of threads
+    std::vector<RPTree> forest(n_trees);
+    auto build_tree = [&points, n_points, &forest](uint32_t tree_idx){
+        RPTree &tree = forest[tree_idx];
+        std::mt19937 gen(RP_FOREST_SEED + tree_idx);
+        std::vector<float> projections(n_points);
+        tree.point_idxes.resize(n_points);
+        std::iota(tree.point_idxes.begin(), tree.point_idxes.end(), 0);
+        BuildRPTreeNode(points, tree, 0, n_points, gen, projections);
+    };
+    if(n_threads == 1){
+        for(uint32_t tree_idx = 0; tree_idx < n_trees; tree_idx++){
+            build_tree(tree_idx);
+        }
+    }
+    else{
+        GetThreadPool(n_threads).ParallelFor(n_trees, build_tree);
+    }
+
+    ForEachQueryChunk(n_queries, n_threads, [&](uint32_t query_begin, uint32_t query_end){
+        std::vector<uint32_t> visit_stamps(n_points, 0);
+        std::vector<uint32_t> candidates;
+        std::vector<std::pair<float, uint32_t>> scored_candidates;
+        for(uint32_t query_idx = query_begin; query_idx < query_end; query_idx++){
+            const uint32_t offset = neighbor_lists.offsets[query_idx];
+            const uint32_t k = neighbor_lists.offsets[query_idx + 1] - offset;
+            if(k == 0){
+                continue;
+            }
+            TopK top_k = {k, 0, &neighbor_lists.distances[offset], &neighbor_lists.idxes[offset]};
+            const uint32_t search_k = n_trees * std::max(k, (uint32_t)RP_TREE_LEAF_SIZE) * RP_FOREST_SEARCH_FACTOR;
+            QueryRPForest(forest, points, queries.Point(query_idx), search_k, query_idx - query_begin + 1, 
+                            visit_stamps, candidates, scored_candidates, top_k);
+            for(uint32_t neighbor_idx = 0; neighbor_idx < top_k.size; neighbor_idx++){
+                top_k.square_distances[neighbor_idx] = sqrt(top_k.square_distances[neighbor_idx]);
+            }
+        }
+    });
+}
+
+void SearchKNearestNeighbors(const PointSet &points, const PointSet &queries, const uint32_t *ks, const NeighborSearchParameters &parameters, 
+                                NeighborLists &neighbor_lists)
+{
+    if(parameters.algorithm == "exact"){
+        FindKNearestNeighbors(points, queries, ks, parameters.n_threads, neighbor_lists);
+    }
+    else if(parameters.algorithm == "rp_forest"){
+        FindApproximateKNearestNeighbors(points, queries, ks, parameters.n_trees, parameters.n_threads, neighbor_lists);
+    }
+    else{
+        printf("./%s:%d: error: unknown neighbour search algorithm %s\n", __FILE__, __LINE__, parameters.algorithm.c_str());
+        exit(1);
+    }
+}
@@ -0,0 +1,161 @@
+#include "../inc/thread_pool.h"
+
+// Pool and task queue owned by the current thread, queue 0 belongs to threads outside any pool
+static thread_local const ThreadPool *current_pool = NULL;
+static thread_local uint32_t current_queue_idx = 0;
+
+ThreadPool::ThreadPool(const uint32_t n_threads)
+    : n_threads_((n_threads == 0)? 1 : n_threads), is_stopping_(false), n_queued_(0)
+{
+    for(uint32_t queue_idx = 0; queue_idx < n_threads_; queue_idx++){
+        queues_.emplace_back(new TaskQueue);
+    }
+    for(uint32_t queue_idx = 1; queue_idx < n_threads_; queue_idx++){
+        workers_.emplace_back(&ThreadPool::WorkerMain, this, queue_idx);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        is_stopping_ = true;
+    }
+    has_work_.notify_all();
+    for(uint32_t worker_idx = 0; worker_idx < workers_.size(); worker_idx++){
+        workers_[worker_idx].join();
+    }
+}
+
+uint32_t ThreadPool::GetQueueIdx() const
+{
+    return (current_pool == this)? current_queue_idx : 0;
+}
+
+// Pop from the back of our own queue, otherwise steal from the front of the others
+bool ThreadPool::TryPopTask(const uint32_t queue_idx, Task &task)
+{
+    if(n_queued_ == 0){
+        return false;
+    }
+
+    {
+        TaskQueue &queue = *queues_[queue_idx];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if(!queue.tasks.empty()){
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+            n_queued_--;
+            return true;
+        }
+    }
+
+    for(uint32_t offset = 1; offset < n_threads_; offset++){
+        TaskQueue &queue = *queues_[(queue_idx + offset) % n_threads_];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if(!queue.tasks.empty()){
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            n_queued_--;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ThreadPool::RunTask(Task &task)
+{
+    task.function();
+    if(--task.group->n_pending_ == 0){
+        // Take the lock so that a thread about to sleep in Wait cannot miss the notification
+        std::lock_guard<std::mutex> lock(mutex_);
+        has_work_.notify_all();
+    }
+}
+
+void ThreadPool::WorkerMain(const uint32_t queue_idx)
+{
+    current_pool = this;
+    current_queue_idx = queue_idx;
+    
+    Task task;
+    while(true){
+        if(TryPopTask(queue_idx, task)){
+            RunTask(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        has_work_.wait(lock, [this]{return is_stopping_ || n_queued_ > 0;});
+        if(is_stopping_ && n_queued_ == 0){
+            return;
+        }
+    }
+}
+
+void ThreadPool::Spawn(TaskGroup &group, std::function<void()> task)
+{
+    group.n_pending_++;
+    if(workers_.empty()){
+        task();
+        group.n_pending_--;
+        return;
+    }
+
+    {
+        TaskQueue &queue = *queues_[GetQueueIdx()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back({std::move(task), &group});
+        n_queued_++;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    has_work_.notify_all();
+}
+
+void ThreadPool::Wait(TaskGroup &group)
+{
+    const uint32_t queue_idx = GetQueueIdx();
+    Task task;
+    while(group.n_pending_ > 0){
+        if(TryPopTask(queue_idx, task)){
+            RunTask(task);
+            continue;
+        }
+
+        // The remaining tasks of the group are running on other threads
+        std::unique_lock<std::mutex> lock(mutex_);
+        has_work_.wait(lock, [this, &group]{return group.n_pending_ == 0 || n_queued_ > 0;});
+    }
+}
+
+void ThreadPool::ParallelFor(const uint32_t n_iterations, const std::function<void(uint32_t)> &body)
+{
+    if(workers_.empty() || n_iterations <= 1){
+        for(uint32_t idx = 0; idx < n_iterations; idx++){
+            body(idx);
+        }
+        return;
+    }
+
+    std::atomic<uint32_t> next_idx(0);
+    auto run_iterations = [&next_idx, n_iterations, &body]{
+        for(uint32_t idx = next_idx++; idx < n_iterations; idx = next_idx++){
+            body(idx);
+        }
+    };
+
+    TaskGroup group;
+    const uint32_t n_tasks = std::min(n_threads_, n_iterations);
+    for(uint32_t task_idx = 1; task_idx < n_tasks; task_idx++){
+        Spawn(group, run_iterations);
+    }
+    run_iterations();
+    Wait(group);
+}
+
+ThreadPool &GetThreadPool(const uint32_t n_threads)
+{
+    static ThreadPool thread_pool((n_threads == 0)? std::thread::hardware_concurrency() : n_threads);
+    return thread_pool;
+}
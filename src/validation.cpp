@@ -1,13 +1,33 @@
 #include "../inc/validation.h"
 
-static Accuracies CalcAccForDecisionTree(const std::vector<std::vector<float>> &testing_set, 
-                                            const uint32_t n_training_classes, 
-                                                TreeNode *root)
+void AddToConfusionMatrix(const FlatTree &tree, const DataMatrix &testing_set, std::vector<std::vector<uint32_t>> &confusion_matrix)
+{
+    const uint32_t n_features = testing_set.n_features;
+
+    // Predict the whole testing set at once from a column-major copy
+    const uint32_t n_testing_samples = testing_set.n_samples;
+    std::vector<float> testing_samples((size_t)n_features * n_testing_samples);
+    for(uint32_t testing_data_idx = 0; testing_data_idx < n_testing_samples; testing_data_idx++){
+        const float *row = testing_set.Row(testing_data_idx);
+        for(uint32_t feature_idx = 0; feature_idx < n_features; feature_idx++){
+            testing_samples[(size_t)feature_idx * n_testing_samples + testing_data_idx] = row[feature_idx];
+        }
+    }
+    std::vector<uint32_t> predicted_labels(n_testing_samples);
+    PredictBatchByFlatTree(tree, testing_samples.data(), n_testing_samples, n_testing_samples, predicted_labels.data());
+
+    for(uint32_t testing_data_idx = 0; testing_data_idx < n_testing_samples; testing_data_idx++){
+        uint32_t data_label      = testing_set.labels[testing_data_idx];         // Ground truth
+        uint32_t predicted_label = predicted_labels[testing_data_idx];            // Prediction
+        confusion_matrix[predicted_label][data_label]++;
+    }
+}
+
+Accuracies CalcAccuracies(const std::vector<std::vector<uint32_t>> &confusion_matrix, const uint32_t n_training_classes)
 {
     // The number of classes in the testing set may be smaller than in the training set
     // n_testing_classes <= n_training_classes
     uint32_t n_testing_classes = 0;
-    const uint32_t data_label_idx = testing_set[0].size() - 1;
      
     Accuracies accuracies = {
         .macro_precision  = 0.f,
@@ -15,15 +35,9 @@ static Accuracies CalcAccForDecisionTree(const std::vector<std::vector<float>> &
         .macro_f1_score   = 0.f,
         .g_mean           = 1.f,
         .macro_FDR        = 0.f,
-        .confusion_matrix = std::vector<std::vector<uint32_t>>(n_training_classes + 1, std::vector<uint32_t>(n_training_classes + 1, 0))
+        .confusion_matrix = confusion_matrix
     };
 
-    for(uint32_t testing_data_idx = 0; testing_data_idx < testing_set.size(); testing_data_idx++){
-        uint32_t data_label      = testing_set[testing_data_idx][data_label_idx];               // Ground truth
-        uint32_t predicted_label = PredictByDecisionTree(root, testing_set[testing_data_idx]);  // Prediction
-        accuracies.confusion_matrix[predicted_label][data_label]++;
-    }
-
     // Read confusion matrix
     for(uint32_t class_idx = 1; class_idx <= n_training_classes; class_idx++){ // Class labels start from 1
         // In case there are no samples with a specific class in the testing set.
@@ -84,19 +98,34 @@ static Accuracies CalcAccForDecisionTree(const std::vector<std::vector<float>> &
     return accuracies;
 }
 
-Accuracies Validation(const std::vector<std::vector<float>> &training_set, 
-                        const std::vector<std::vector<float>> &testing_set, 
+Accuracies Validation(const DataMatrix &training_set, 
+                        const DataMatrix &testing_set, 
                             const uint32_t n_training_classes, 
                                 const ModelParameters model_parameters)
+{
+    std::vector<uint32_t> training_idxes(training_set.n_samples);
+    std::iota(training_idxes.begin(), training_idxes.end(), 0);
+    return Validation(training_set, training_idxes, testing_set, n_training_classes, model_parameters);
+}
+
+Accuracies Validation(const DataMatrix &training_set, 
+                        const std::vector<uint32_t> &training_idxes, 
+                            const DataMatrix &testing_set, 
+                                const uint32_t n_training_classes, 
+                                    const ModelParameters model_parameters)
 {
     Accuracies accuracies;
     if(model_parameters.model_type == "decision_tree"){
-        TreeNode *root = CreateDecisionTree(training_set, n_training_classes, model_parameters.min_samples_split, model_parameters.max_purity);
-        accuracies = CalcAccForDecisionTree(testing_set, n_training_classes, root);
+        // The tree and all of its nodes are released when it goes out of scope
+        DecisionTree tree = CreateDecisionTree(training_set, training_idxes, n_training_classes, model_parameters.min_samples_split, 
+                                                model_parameters.max_purity, model_parameters.split_algorithm, model_parameters.n_threads);
+        std::vector<std::vector<uint32_t>> confusion_matrix(n_training_classes + 1, std::vector<uint32_t>(n_training_classes + 1, 0));
+        AddToConfusionMatrix(CompileDecisionTree(tree.root), testing_set, confusion_matrix);
+        accuracies = CalcAccuracies(confusion_matrix, n_training_classes);
     }
     /**
      * Add other multiclass classifiers here
      */
 
     return accuracies;
-}
+}
\ No newline at end of file
@@ -0,0 +1,79 @@
+#include "../inc/weighted_sampler.h"
+
+WeightedSampler::WeightedSampler(const std::vector<float> &weights)
+    : weights_(weights), tree_(weights.size() + 1, 0.0), total_weight_(0.0), n_positive_(0), highest_bit_(1)
+{
+    // Linear-time build: every node passes its sum on to its parent
+    for(uint32_t idx = 0; idx < weights_.size(); idx++){
+        if(weights_[idx] < 0.f){
+            printf("./%s:%d: error: negative sampling weight %f\n", __FILE__, __LINE__, weights_[idx]);
+            exit(1);
+        }
+        tree_[idx + 1] += weights_[idx];
+        const uint32_t parent = (idx + 1) + ((idx + 1) & -(idx + 1));
+        if(parent <= weights_.size()){
+            tree_[parent] += tree_[idx + 1];
+        }
+        total_weight_ += weights_[idx];
+        n_positive_ += weights_[idx] > 0.f;
+    }
+    while((highest_bit_ << 1) <= weights_.size()){
+        highest_bit_ <<= 1;
+    }
+}
+
+uint32_t WeightedSampler::FindPrefix(double target) const
+{
+    uint32_t position = 0;
+    for(uint32_t step = highest_bit_; step > 0; step >>= 1){
+        if(position + step <= weights_.size() && tree_[position + step] <= target){
+            position += step;
+            target -= tree_[position];
+        }
+    }
+    return position; // 0-based index of the element after the prefix
+}
+
+uint32_t WeightedSampler::Draw(std::mt19937 &gen) const
+{
+    if(n_positive_ == 0){
+        printf("./%s:%d: error: draw from weights that are all 0\n", __FILE__, __LINE__);
+        exit(1);
+    }
+
+    // Rounding in the partial sums can land the target on a zero weight or past the end, draw again in that case
+    std::uniform_real_distribution<> distrib(0.0, total_weight_);
+    uint32_t idx;
+    do{
+        idx = FindPrefix(distrib(gen));
+    }
+    while(idx >= weights_.size() || weights_[idx] == 0.f);
+    return idx;
+}
+
+uint32_t WeightedSampler::DrawAndRemove(std::mt19937 &gen)
+{
+    uint32_t idx = Draw(gen);
+    SetWeight(idx, 0.f);
+    return idx;
+}
+
+void WeightedSampler::SetWeight(const uint32_t idx, const float weight)
+{
+    if(weight < 0.f){
+        printf("./%s:%d: error: negative sampling weight %f\n", __FILE__, __LINE__, weight);
+        exit(1);
+    }
+    const double delta = (double)weight - weights_[idx];
+    n_positive_ += (weight > 0.f) - (weights_[idx] > 0.f);
+    weights_[idx] = weight;
+    for(uint32_t position = idx + 1; position <= weights_.size(); position += position & -position){
+        tree_[position] += delta;
+    }
+
+    // Recompute the total from the tree instead of accumulating deltas
+    total_weight_ = 0.0;
+    for(uint32_t position = weights_.size(); position > 0; position -= position & -position){
+        total_weight_ += tree_[position];
+    }
+}